@@ -0,0 +1,406 @@
+// Benchmark of the GimbalNode against a simulated gimbal.
+//
+// A fake gimbal streams RAW_IMU, MOUNT_STATUS and MOUNT_ORIENTATION over a pseudo terminal,
+// which the GimbalNode running in this process opens as its serial device. The benchmark
+// subscribes to the published topics and reports throughput, dropped samples, the end-to-end
+// latency from the serial write to the subscriber, CPU use and heap allocations. The MAVLink
+// to ROS conversions are timed in isolation beforehand.
+//
+// Run with: roslaunch ros_gremsy bench.launch imu_rate:=200 duration:=10
+#include <ros_gremsy/ros_gremsy.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <array>
+#include <new>
+
+// Heap allocations of the whole process, counted once the measurement started
+static std::atomic<bool> count_allocations{false};
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size)
+{
+    if(count_allocations.load(std::memory_order_relaxed))
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* pointer = malloc(size);
+    if(!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept
+{
+    free(pointer);
+}
+
+// The IMU samples carry a sequence number in zacc, which allows the latency to be measured
+#define SEQUENCE_RANGE 30000
+
+// Simulated gimbal on the master side of a pseudo terminal
+class FakeGimbal
+{
+public:
+    // Params: (rates in Hz for each stream, 0 disables a stream)
+    FakeGimbal(double imu_rate, double mount_status_rate, double mount_orientation_rate) :
+        imu_rate_(imu_rate),
+        mount_status_rate_(mount_status_rate),
+        mount_orientation_rate_(mount_orientation_rate)
+    {
+        for(auto& time : imu_send_times_)
+        {
+            time = 0;
+        }
+    }
+
+    ~FakeGimbal()
+    {
+        stop();
+        if(slave_fd_ >= 0)
+        {
+            close(slave_fd_);
+        }
+        if(master_fd_ >= 0)
+        {
+            close(master_fd_);
+        }
+    }
+
+    // Creates the pseudo terminal, returns false on failure
+    bool open()
+    {
+        master_fd_ = posix_openpt(O_RDWR | O_NOCTTY);
+        if(master_fd_ < 0 || grantpt(master_fd_) != 0 || unlockpt(master_fd_) != 0)
+        {
+            return false;
+        }
+        device_ = ptsname(master_fd_);
+
+        // Keep the slave open and raw, so no data is mangled before the node configured the port
+        slave_fd_ = ::open(device_.c_str(), O_RDWR | O_NOCTTY);
+        if(slave_fd_ < 0)
+        {
+            return false;
+        }
+        termios config;
+        tcgetattr(slave_fd_, &config);
+        cfmakeraw(&config);
+        tcsetattr(slave_fd_, TCSANOW, &config);
+
+        fcntl(master_fd_, F_SETFL, fcntl(master_fd_, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    // Device path the node has to open
+    const std::string& device() const
+    {
+        return device_;
+    }
+
+    void start()
+    {
+        running_ = true;
+        thread_ = std::thread(&FakeGimbal::run, this);
+    }
+
+    void stop()
+    {
+        running_ = false;
+        if(thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    // Monotonic time the IMU sample with the given sequence number was written
+    int64_t imuSendTime(int sequence) const
+    {
+        return imu_send_times_[sequence % SEQUENCE_RANGE];
+    }
+
+    std::atomic<uint64_t> imu_sent{0}, mount_status_sent{0}, mount_orientation_sent{0};
+    // CPU time used by the fake gimbal thread, so it can be excluded from the measurement
+    std::atomic<int64_t> cpu_time{0};
+
+private:
+    void run()
+    {
+        typedef std::chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+        clock::time_point next_heartbeat = start, next_imu = start, next_status = start, next_orientation = start;
+
+        while(running_)
+        {
+            clock::time_point now = clock::now();
+            uint64_t time_usec = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+
+            if(now >= next_heartbeat)
+            {
+                mavlink_message_t message;
+                mavlink_msg_heartbeat_pack(system_id, component_id, &message, 26, 0, 0, 0, 4);
+                send(message);
+                next_heartbeat += std::chrono::seconds(1);
+            }
+            if(imu_rate_ > 0.0 && now >= next_imu)
+            {
+                int sequence = imu_sent % SEQUENCE_RANGE;
+                mavlink_raw_imu_t raw_imu;
+                memset(&raw_imu, 0, sizeof(raw_imu));
+                raw_imu.time_usec = time_usec;
+                raw_imu.zacc = sequence;
+                mavlink_message_t message;
+                mavlink_msg_raw_imu_encode(system_id, component_id, &message, &raw_imu);
+                imu_send_times_[sequence] = monotonicNanoseconds();
+                send(message);
+                imu_sent++;
+                next_imu += period(imu_rate_);
+            }
+            if(mount_status_rate_ > 0.0 && now >= next_status)
+            {
+                mavlink_mount_status_t mount_status;
+                memset(&mount_status, 0, sizeof(mount_status));
+                mount_status.pointing_a = mount_status_sent % 90;
+                mavlink_message_t message;
+                mavlink_msg_mount_status_encode(system_id, component_id, &message, &mount_status);
+                send(message);
+                mount_status_sent++;
+                next_status += period(mount_status_rate_);
+            }
+            if(mount_orientation_rate_ > 0.0 && now >= next_orientation)
+            {
+                mavlink_mount_orientation_t mount_orientation;
+                memset(&mount_orientation, 0, sizeof(mount_orientation));
+                mount_orientation.time_boot_ms = time_usec / 1000;
+                mount_orientation.yaw = mount_orientation_sent % 360;
+                mavlink_message_t message;
+                mavlink_msg_mount_orientation_encode(system_id, component_id, &message, &mount_orientation);
+                send(message);
+                mount_orientation_sent++;
+                next_orientation += period(mount_orientation_rate_);
+            }
+
+            // Discard everything the node sends, so its writes never block
+            uint8_t buffer[256];
+            while(read(master_fd_, buffer, sizeof(buffer)) > 0);
+
+            timespec cpu;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+            cpu_time = cpu.tv_sec * 1000000000LL + cpu.tv_nsec;
+
+            std::this_thread::sleep_until(std::min({next_heartbeat, next_imu, next_status, next_orientation}));
+        }
+    }
+
+    void send(const mavlink_message_t& message)
+    {
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+        if(write(master_fd_, buffer, length) != length)
+        {
+            ROS_WARN_THROTTLE(1.0, "Fake gimbal could not write a complete message");
+        }
+    }
+
+    static std::chrono::steady_clock::duration period(double rate)
+    {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    }
+
+    static constexpr uint8_t system_id = 1;
+    static constexpr uint8_t component_id = 154; // MAV_COMP_ID_GIMBAL
+
+    double imu_rate_, mount_status_rate_, mount_orientation_rate_;
+    int master_fd_ = -1, slave_fd_ = -1;
+    std::string device_;
+    std::array<std::atomic<int64_t>, SEQUENCE_RANGE> imu_send_times_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+};
+
+// Counts the received messages and measures the IMU latency
+class BenchSubscriber
+{
+public:
+    BenchSubscriber(ros::NodeHandle& pnh, FakeGimbal& gimbal) : gimbal_(gimbal)
+    {
+        imu_sub_ = pnh.subscribe("imu/data", 1000, &BenchSubscriber::imuCallback, this);
+        encoder_sub_ = pnh.subscribe("encoder", 1000, &BenchSubscriber::encoderCallback, this);
+        orientation_sub_ = pnh.subscribe("mount_orientation_local_yaw", 1000, &BenchSubscriber::orientationCallback, this);
+    }
+
+    void imuCallback(const sensor_msgs::ImuConstPtr& message)
+    {
+        int64_t receive_time = monotonicNanoseconds();
+        int64_t send_time = gimbal_.imuSendTime((int) message->linear_acceleration.z);
+        if(send_time > 0)
+        {
+            imu_latency.record(receive_time - send_time);
+        }
+        imu_received++;
+    }
+
+    void encoderCallback(const geometry_msgs::Vector3StampedConstPtr& message)
+    {
+        encoder_received++;
+    }
+
+    void orientationCallback(const geometry_msgs::QuaternionConstPtr& message)
+    {
+        orientation_received++;
+    }
+
+    std::atomic<uint64_t> imu_received{0}, encoder_received{0}, orientation_received{0};
+    LatencyHistogram imu_latency;
+
+private:
+    FakeGimbal& gimbal_;
+    ros::Subscriber imu_sub_, encoder_sub_, orientation_sub_;
+};
+
+// CPU time of the whole process in nanoseconds
+static int64_t processCpuTime()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000LL +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+// Mean time of a single conversion in nanoseconds, without the rest of the node
+template<typename Variant = void, typename Mavlink, typename Ros>
+static double conversionTime(Mavlink& message, Ros& ros_message, int iterations)
+{
+    int64_t start = monotonicNanoseconds();
+    for(int i = 0; i < iterations; i++)
+    {
+        convertMavlink<Variant>(message, ros_message);
+        // The messages may change behind the back of the compiler, so no iteration is optimized away
+        asm volatile("" : : "r"(&message), "r"(&ros_message) : "memory");
+    }
+    return (double) (monotonicNanoseconds() - start) / iterations;
+}
+
+static void benchmarkConversions(int iterations)
+{
+    mavlink_raw_imu_t raw_imu;
+    memset(&raw_imu, 0, sizeof(raw_imu));
+    raw_imu.xacc = 12;
+    raw_imu.zacc = -1000;
+    raw_imu.ygyro = 7;
+    sensor_msgs::Imu imu;
+
+    mavlink_mount_status_t mount_status;
+    memset(&mount_status, 0, sizeof(mount_status));
+    mount_status.pointing_a = 30;
+    mount_status.pointing_c = -120;
+    geometry_msgs::Vector3 encoder;
+
+    mavlink_mount_orientation_t mount_orientation;
+    memset(&mount_orientation, 0, sizeof(mount_orientation));
+    mount_orientation.roll = 1.5f;
+    mount_orientation.pitch = -30.0f;
+    mount_orientation.yaw = 45.0f;
+    mount_orientation.yaw_absolute = 170.0f;
+    geometry_msgs::Quaternion orientation;
+
+    ROS_INFO("Conversions over %d iterations:", iterations);
+    ROS_INFO("imu                %.1f ns", conversionTime(raw_imu, imu, iterations));
+    ROS_INFO("encoder            %.1f ns", conversionTime(mount_status, encoder, iterations));
+    ROS_INFO("orientation local  %.1f ns", conversionTime<LocalYaw>(mount_orientation, orientation, iterations));
+    ROS_INFO("orientation global %.1f ns", conversionTime<GlobalYaw>(mount_orientation, orientation, iterations));
+}
+
+static void report(const char* stream, uint64_t sent, uint64_t received, double duration)
+{
+    double dropped = sent > 0 ? 100.0 * ((double) sent - (double) received) / sent : 0.0;
+    ROS_INFO("%-18s sent %8lu  received %8lu  %8.1f msg/s  dropped %6.2f %%",
+        stream, sent, received, received / duration, dropped);
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "ros_gremsy_bench");
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    double imu_rate, mount_status_rate, mount_orientation_rate, duration, warmup;
+    pnh.param("bench_imu_rate", imu_rate, 200.0);
+    pnh.param("bench_mount_status_rate", mount_status_rate, 50.0);
+    pnh.param("bench_mount_orientation_rate", mount_orientation_rate, 50.0);
+    pnh.param("bench_duration", duration, 10.0);
+    pnh.param("bench_warmup", warmup, 2.0);
+    int conversion_iterations;
+    pnh.param("bench_conversion_iterations", conversion_iterations, 1000000);
+
+    if(conversion_iterations > 0)
+    {
+        benchmarkConversions(conversion_iterations);
+    }
+
+    FakeGimbal gimbal(imu_rate, mount_status_rate, mount_orientation_rate);
+    if(!gimbal.open())
+    {
+        ROS_FATAL("Could not create the pseudo terminal for the fake gimbal: %s", strerror(errno));
+        return 1;
+    }
+    gimbal.start();
+
+    // The node reads its config from the private namespace of this process
+    pnh.setParam("device", gimbal.device());
+    GimbalNode node(nh, pnh);
+
+    BenchSubscriber subscriber(pnh, gimbal);
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+
+    ros::WallDuration(warmup).sleep();
+
+    // Measure only the steady state
+    uint64_t imu_sent = gimbal.imu_sent, imu_received = subscriber.imu_received;
+    uint64_t status_sent = gimbal.mount_status_sent, status_received = subscriber.encoder_received;
+    uint64_t orientation_sent = gimbal.mount_orientation_sent, orientation_received = subscriber.orientation_received;
+    int64_t cpu_start = processCpuTime() - gimbal.cpu_time;
+    subscriber.imu_latency.collect();
+    count_allocations = true;
+
+    ros::WallDuration(duration).sleep();
+
+    count_allocations = false;
+    uint64_t measured_allocations = allocations;
+    int64_t cpu_end = processCpuTime() - gimbal.cpu_time;
+    imu_sent = gimbal.imu_sent - imu_sent;
+    imu_received = subscriber.imu_received - imu_received;
+    status_sent = gimbal.mount_status_sent - status_sent;
+    status_received = subscriber.encoder_received - status_received;
+    orientation_sent = gimbal.mount_orientation_sent - orientation_sent;
+    orientation_received = subscriber.orientation_received - orientation_received;
+    LatencyHistogram::Summary latency = subscriber.imu_latency.collect();
+
+    uint64_t published = imu_received + status_received + orientation_received;
+
+    ROS_INFO("Benchmark over %.1f s:", duration);
+    report("imu", imu_sent, imu_received, duration);
+    report("encoder", status_sent, status_received, duration);
+    report("mount_orientation", orientation_sent, orientation_received, duration);
+    ROS_INFO("imu latency [ms]   mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f",
+        latency.mean * 1e3, latency.p50 * 1e3, latency.p90 * 1e3, latency.p99 * 1e3, latency.max * 1e3);
+    ROS_INFO("cpu                %.1f %% of one core (excluding the fake gimbal)",
+        100.0 * (cpu_end - cpu_start) * 1e-9 / duration);
+    ROS_INFO("allocations        %lu (%.2f per received message, including roscpp and the subscribers)",
+        measured_allocations, published > 0 ? (double) measured_allocations / published : 0.0);
+
+    spinner.stop();
+    gimbal.stop();
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <ros/ros.h>
+#include <mutex>
+#include <vector>
+
+// Maps the microsecond clock of the gimbal onto the ROS clock.
+// The offset and drift between both clocks are estimated by a linear fit
+// of the device time stamps against their receive times over a sliding window.
+class ClockSync
+{
+public:
+    // Params: (number of samples used for the fit)
+    explicit ClockSync(size_t window_size = 100);
+    // Adds a sample and returns its device time stamp mapped onto the ROS clock
+    ros::Time update(uint64_t device_usec, const ros::Time& receive_time);
+    // Maps a device time stamp onto the ROS clock by using the current fit
+    ros::Time toROSTime(uint64_t device_usec) const;
+    // Drops all samples, e.g. after the device clock has been reset
+    void reset();
+    // Changes the number of samples used for the fit
+    void setWindowSize(size_t window_size);
+private:
+    // Drops all samples, the mutex has to be held
+    void clear();
+    // Recalculates the linear fit for the samples in the window
+    void fit();
+    // Maps a device time stamp onto the ROS clock, the mutex has to be held
+    ros::Time map(uint64_t device_usec) const;
+
+    // Sample pairs relative to the origin in seconds (device time, receive time)
+    std::vector<std::pair<double, double>> samples_;
+    // Index of the oldest sample once the window is full
+    size_t next_sample_;
+    size_t window_size_;
+    // First sample after a reset, all other samples are relative to it
+    uint64_t device_origin_;
+    ros::Time receive_origin_;
+    uint64_t last_device_usec_;
+    // Result of the fit: receive = offset + drift * device
+    double offset_;
+    double drift_;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <sensor_msgs/Imu.h>
+#include <geometry_msgs/Quaternion.h>
+#include <geometry_msgs/Vector3.h>
+#include <cmath>
+#include <type_traits>
+#include "serial_port.h"
+
+// Conversions of the MAVLink telemetry into ROS messages. Each pair of messages has its own
+// specialization of MavlinkConversion with the scale factors and axis maps as constants, so a
+// conversion compiles into plain loads, multiplications and stores without any branch. Only the
+// fields set by the gimbal are written, so messages from a pool keep everything else.
+
+// Selects the element of a MAVLink triple written into each axis of a ROS vector, e.g. the
+// encoder triple is ordered tilt, roll, pan while ROS expects roll, pitch, yaw
+template<int X, int Y, int Z>
+struct AxisMap
+{
+    static_assert(X >= 0 && X < 3 && Y >= 0 && Y < 3 && Z >= 0 && Z < 3, "Axes have to be 0, 1 or 2");
+
+    template<typename T>
+    static void apply(const T (&values)[3], double scale, geometry_msgs::Vector3& vector)
+    {
+        vector.x = scale * values[X];
+        vector.y = scale * values[Y];
+        vector.z = scale * values[Z];
+    }
+};
+
+// Selects which yaw of the mount orientation is converted
+struct LocalYaw {};
+struct GlobalYaw {};
+
+template<typename Mavlink, typename Ros, typename Variant = void>
+struct MavlinkConversion;
+
+// Raw counts of the IMU, the IMU filter applies the calibrated scales if enabled
+template<>
+struct MavlinkConversion<mavlink_raw_imu_t, sensor_msgs::Imu>
+{
+    static constexpr double accel_scale = 1.0;
+    static constexpr double gyro_scale = 1.0;
+    typedef AxisMap<0, 1, 2> Axes;
+
+    static void convert(const mavlink_raw_imu_t& message, sensor_msgs::Imu& imu)
+    {
+        const int16_t accel[3] = {message.xacc, message.yacc, message.zacc};
+        const int16_t gyro[3] = {message.xgyro, message.ygyro, message.zgyro};
+        Axes::apply(accel, accel_scale, imu.linear_acceleration);
+        Axes::apply(gyro, gyro_scale, imu.angular_velocity);
+    }
+};
+
+// Encoder angles in degrees, ordered tilt, roll, pan, into rad ordered roll, tilt, pan
+template<>
+struct MavlinkConversion<mavlink_mount_status_t, geometry_msgs::Vector3>
+{
+    static constexpr double scale = M_PI / 180.0;
+    typedef AxisMap<1, 0, 2> Axes;
+
+    static void convert(const mavlink_mount_status_t& message, geometry_msgs::Vector3& vector)
+    {
+        // The angles pass through float like in the SDK
+        const float pointing[3] = {(float) message.pointing_a, (float) message.pointing_b, (float) message.pointing_c};
+        Axes::apply(pointing, scale, vector);
+    }
+};
+
+// Euler angles in degrees of the camera into a quaternion, with the yaw relative to the mount or the global yaw
+template<typename Yaw>
+struct MavlinkConversion<mavlink_mount_orientation_t, geometry_msgs::Quaternion, Yaw>
+{
+    static constexpr double scale = M_PI / 180.0;
+    static constexpr bool global_yaw = std::is_same<Yaw, GlobalYaw>::value;
+    static_assert(global_yaw || std::is_same<Yaw, LocalYaw>::value, "The yaw has to be LocalYaw or GlobalYaw");
+
+    static void convert(const mavlink_mount_orientation_t& message, geometry_msgs::Quaternion& quaternion)
+    {
+        // Same convention as tf2::Quaternion::setRPY, the result is normalized by construction
+        double half_roll = 0.5 * scale * message.roll;
+        double half_pitch = 0.5 * scale * message.pitch;
+        double half_yaw = 0.5 * scale * (global_yaw ? message.yaw_absolute : message.yaw);
+        double cos_roll = std::cos(half_roll), sin_roll = std::sin(half_roll);
+        double cos_pitch = std::cos(half_pitch), sin_pitch = std::sin(half_pitch);
+        double cos_yaw = std::cos(half_yaw), sin_yaw = std::sin(half_yaw);
+
+        quaternion.x = sin_roll * cos_pitch * cos_yaw - cos_roll * sin_pitch * sin_yaw;
+        quaternion.y = cos_roll * sin_pitch * cos_yaw + sin_roll * cos_pitch * sin_yaw;
+        quaternion.z = cos_roll * cos_pitch * sin_yaw - sin_roll * sin_pitch * cos_yaw;
+        quaternion.w = cos_roll * cos_pitch * cos_yaw + sin_roll * sin_pitch * sin_yaw;
+    }
+};
+
+// Params: (MAVLink message, ROS message to fill)
+// Picks the conversion by the types of both messages, the variant selects between conversions of the same pair
+template<typename Variant = void, typename Mavlink, typename Ros>
+inline void convertMavlink(const Mavlink& message, Ros& ros_message)
+{
+    MavlinkConversion<Mavlink, Ros, Variant>::convert(message, ros_message);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <memory>
+
+// Callback queues and the spinners serving them. A GimbalNode either owns its executor
+// or several nodes share one, so a process with many gimbals keeps a single thread pool.
+class GimbalExecutor
+{
+public:
+    GimbalExecutor() = default;
+    ~GimbalExecutor();
+    // Params: (threads serving the goals, threads serving the telemetry timers)
+    // Starts serving the queues, dynamic reconfigure is always served by a single thread
+    void start(int command_threads, int telemetry_threads);
+    // Waits until no callback runs anymore, afterwards the nodes can be torn down safely
+    void stop();
+
+    // Callback queues for the goals, the telemetry timers and dynamic reconfigure
+    ros::CallbackQueue command_queue, telemetry_queue, reconfigure_queue;
+private:
+    // Spinners serving the callback queues
+    std::unique_ptr<ros::AsyncSpinner> command_spinner_, telemetry_spinner_, reconfigure_spinner_;
+};
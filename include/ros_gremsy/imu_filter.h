@@ -0,0 +1,76 @@
+#pragma once
+#include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
+#include <tf2/LinearMath/Quaternion.h>
+
+// Second order IIR filter applied to the 6 IMU axes with shared coefficients.
+// The axes are stored side by side, so the filter loop is vectorized by the compiler.
+struct ImuBiquad
+{
+    static const int AXES = 6;
+
+    // Designs a Butterworth low pass, disables the filter if the cutoff is not below the Nyquist frequency
+    void designLowPass(double cutoff, double sample_rate);
+    // Designs a notch with the given center frequency and -3 dB bandwidth
+    void designNotch(double frequency, double bandwidth, double sample_rate);
+    // Filters all axes in place
+    void apply(double values[AXES]);
+    // Starts the next sample from the given values to avoid a transient
+    void reset(const double values[AXES]);
+
+    bool enabled = false;
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    double x1[AXES] = {}, x2[AXES] = {}, y1[AXES] = {}, y2[AXES] = {};
+};
+
+// Turns the raw IMU counts of the gimbal into calibrated and filtered measurements
+// and estimates the orientation by a complementary filter of gyro and accelerometer.
+// The yaw is not observable by the accelerometer, so it drifts with the gyro bias.
+class ImuFilter
+{
+public:
+    struct Parameters
+    {
+        // Scale factors from counts to m/s^2 and rad/s
+        double accel_scale = 1.0;
+        double gyro_scale = 1.0;
+        // Cutoff of the low pass in Hz, 0 disables it
+        double lowpass_cutoff = 0.0;
+        // Center frequency and bandwidth of the notch in Hz, a frequency of 0 disables it
+        double notch_frequency = 0.0;
+        double notch_bandwidth = 1.0;
+        // Time constant in s in which the gyro bias follows the gyro while the gimbal rests, 0 disables the estimation
+        double bias_time_constant = 0.0;
+        // Angular rate in rad/s below which the gimbal is considered at rest
+        double stationary_threshold = 0.05;
+        // Time constant in s in which the tilt follows the accelerometer
+        double orientation_time_constant = 1.0;
+        // Standard deviations reported in the covariances
+        double accel_noise = 0.0;
+        double gyro_noise = 0.0;
+        double orientation_noise = 0.0;
+    };
+
+    // Applies new parameters while keeping the estimated state
+    void configure(const Parameters& parameters);
+    // Drops the estimated state, e.g. after a gap in the data
+    void reset();
+    // Converts a message with raw counts in place and fills its orientation and covariances
+    void update(sensor_msgs::Imu& imu);
+    // Current estimate of the gyro bias in rad/s
+    const double* gyroBias() const { return gyro_bias_; }
+private:
+    // Designs the filters for the estimated sample rate
+    void designFilters();
+
+    Parameters parameters_;
+    ImuBiquad lowpass_, notch_;
+    // Sample rate the filters are designed for, 0 while it is estimated
+    double design_rate_ = 0.0;
+    double mean_period_ = 0.0;
+    size_t period_samples_ = 0;
+    ros::Time last_stamp_;
+    bool initialized_ = false;
+    double gyro_bias_[3] = {};
+    tf2::Quaternion orientation_{0.0, 0.0, 0.0, 1.0};
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Monotonic time in nanoseconds, used for all stage timings
+inline int64_t monotonicNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Wall clock time in microseconds, the clock used by the SDK for its receive time stamps
+inline int64_t wallClockMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Lock-free histogram of durations with logarithmic buckets (four per octave),
+// which allows percentiles to be estimated without storing the samples.
+class LatencyHistogram
+{
+public:
+    // Statistics of a period, all durations in seconds
+    struct Summary
+    {
+        uint64_t count = 0;
+        double mean = 0.0;
+        double p50 = 0.0;
+        double p90 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    LatencyHistogram();
+    // Adds a duration in nanoseconds, may be called from any thread
+    void record(int64_t nanoseconds);
+    // Returns the statistics of the samples recorded since the last call and starts a new period
+    Summary collect();
+
+private:
+    static constexpr size_t buckets_per_octave = 4;
+    // Covers durations up to 2^32 ns (about 4 s), longer ones end up in the last bucket
+    static constexpr size_t num_buckets = 32 * buckets_per_octave;
+
+    // Upper bound of a bucket in nanoseconds
+    static double bucketUpperBound(size_t bucket);
+
+    std::array<std::atomic<uint64_t>, num_buckets> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
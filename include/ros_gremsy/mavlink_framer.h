@@ -0,0 +1,69 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <sys/types.h>
+#include <vector>
+
+// A MAVLink packet inside the receive buffer of the framer, only valid during the handler call
+struct MavlinkPacket
+{
+    uint32_t message_id;
+    // Incremented by the sender with every packet, a gap shows lost packets
+    uint8_t sequence;
+    uint8_t system_id;
+    uint8_t component_id;
+    const uint8_t* payload;
+    size_t payload_length;
+    // The complete packet as received, including header, checksum and signature
+    const uint8_t* data;
+    size_t length;
+    // Monotonic time in ns when the read completing the packet returned, the clock of monotonicNanoseconds()
+    int64_t receive_time;
+
+    // Decodes the payload into a MAVLink message struct. The structs are laid out in wire order,
+    // so this is a single copy, truncated trailing zeros of MAVLink 2 are restored.
+    template<typename T>
+    void decode(T& message) const
+    {
+        size_t copied = std::min(payload_length, sizeof(T));
+        memcpy(&message, payload, copied);
+        memset(reinterpret_cast<uint8_t*>(&message) + copied, 0, sizeof(T) - copied);
+    }
+};
+
+// Frames MAVLink 1 and 2 packets in place. Every read pulls as many bytes as available into
+// the buffer, the packets are checked and handed to the handler without copying them.
+// Only messages of the dialect can be checked, so all others are skipped.
+class MavlinkFramer
+{
+public:
+    typedef std::function<void(const MavlinkPacket&)> Handler;
+
+    // Params: (size of the receive buffer, called for every packet with a valid checksum)
+    MavlinkFramer(size_t buffer_size, Handler handler);
+    // Reads once from the file descriptor and frames everything received so far.
+    // Returns the result of read, i.e. the number of bytes, 0 at the end of file or -1 on errors.
+    ssize_t readFrom(int fd);
+    // Frames the given bytes, e.g. a datagram which has just been received
+    void feed(const uint8_t* data, size_t length);
+
+    // Number of packets handed to the handler, dropped because of a bad checksum and skipped bytes outside of packets
+    uint64_t packets() const { return packets_; }
+    uint64_t bad_checksums() const { return bad_checksums_; }
+    uint64_t skipped_bytes() const { return skipped_bytes_; }
+    // Number of start bytes followed by a message id without an extra crc, which are skipped as they can not be checked
+    uint64_t unknown_messages() const { return unknown_messages_; }
+private:
+    // Hands all complete packets to the handler and keeps a trailing incomplete one
+    void frame();
+
+    std::vector<uint8_t> buffer_;
+    // Number of valid bytes at the start of the buffer
+    size_t filled_ = 0;
+    // Time of the last read or feed, given to the packets it completed
+    int64_t receive_time_ = 0;
+    Handler handler_;
+    uint64_t packets_ = 0, bad_checksums_ = 0, skipped_bytes_ = 0, unknown_messages_ = 0;
+};
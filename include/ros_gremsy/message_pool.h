@@ -0,0 +1,63 @@
+#pragma once
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Recycles published messages once no subscriber holds a reference to them anymore,
+// so the publishing path does not allocate in the steady state.
+template<typename M>
+class MessagePool
+{
+public:
+    // Params: (number of messages which are allocated up front and recycled)
+    explicit MessagePool(size_t size = 8)
+    {
+        resize(size);
+    }
+
+    // Allocates the pool, must not be called concurrently to acquire
+    void resize(size_t size)
+    {
+        messages_.clear();
+        messages_.reserve(size);
+        for(size_t i = 0; i < size; i++)
+        {
+            messages_.push_back(boost::make_shared<M>());
+        }
+        next_ = 0;
+    }
+
+    // Returns a message which is not referenced anywhere else. The content of the previous use
+    // is left in place, so fields which are not overwritten keep their allocated capacity.
+    boost::shared_ptr<M> acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(size_t i = 0; i < messages_.size(); i++)
+        {
+            boost::shared_ptr<M>& message = messages_[(next_ + i) % messages_.size()];
+            if(message.use_count() == 1)
+            {
+                next_ = (next_ + i + 1) % messages_.size();
+                return message;
+            }
+        }
+
+        // All messages are still held by subscribers
+        allocations_++;
+        return boost::make_shared<M>();
+    }
+
+    // Number of messages which had to be allocated because the pool was exhausted
+    uint64_t allocations() const
+    {
+        return allocations_;
+    }
+
+private:
+    std::vector<boost::shared_ptr<M>> messages_;
+    size_t next_;
+    std::atomic<uint64_t> allocations_{0};
+    std::mutex mutex_;
+};
@@ -1,34 +1,251 @@
 #include <unistd.h>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <tf2/utils.h>
 #include <sensor_msgs/Imu.h>
 #include <geometry_msgs/Vector3Stamped.h>
 #include <geometry_msgs/Quaternion.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <tf2_msgs/TFMessage.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <dynamic_reconfigure/server.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <actionlib/server/action_server.h>
 #include <ros_gremsy/ROSGremsyConfig.h>
+#include <ros_gremsy/ImuBatch.h>
+#include <ros_gremsy/GimbalStatus.h>
+#include <ros_gremsy/GimbalState.h>
+#include <ros_gremsy/PointGimbalAction.h>
 #include <cmath>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <ros_gremsy/clock_sync.h>
+#include <ros_gremsy/converters.h>
+#include <ros_gremsy/imu_filter.h>
+#include <ros_gremsy/gimbal_executor.h>
+#include <ros_gremsy/trajectory.h>
+#include <ros_gremsy/velocity_estimator.h>
+#include <ros_gremsy/transport.h>
+#include <ros_gremsy/telemetry_recorder.h>
+#include <ros_gremsy/thread_scheduling.h>
+#include <ros_gremsy/spsc_queue.h>
+#include <ros_gremsy/seqlock.h>
+#include <ros_gremsy/message_pool.h>
+#include <ros_gremsy/latency_histogram.h>
+#include <ros_gremsy/PipelineStats.h>
 #include "gimbal_interface.h"
 #include "serial_port.h"
 
 #define DEG_TO_RAD (M_PI / 180.0)
 #define RAD_TO_DEG (180.0 / M_PI)
 
+// MAVLink ids used by this node for commands which are not sent by the SDK
+#define COMPANION_SYSTEM_ID 1
+#define COMPANION_COMPONENT_ID 191 // MAV_COMP_ID_ONBOARD_COMPUTER
+
+// Values of the transport parameter
+#define SERIAL_TRANSPORT 0
+#define UDP_TRANSPORT 1
+
+// A stream has a gap if no sample arrived for this many periods of its requested rate
+#define STREAM_GAP_PERIODS 3.0
+// Receive time stamps in microseconds this much older than the last published one are taken as a step of the wall clock
+#define STREAM_CLOCK_STEP 1000000
+
+// MAVLink channel used to encode the recorded messages of the SDK, so the sequence numbers of the SDK are not touched
+#define RECORDER_MAVLINK_CHANNEL MAVLINK_COMM_1
+
+// Book keeping for a single telemetry stream
+struct StreamState
+{
+    // Whether anything consumes the stream, otherwise its samples are dropped unconverted
+    std::atomic<bool> demanded{true};
+    // SDK receive time stamp of the last published message
+    std::atomic<uint64_t> last_stamp{0};
+    // Receive time stamp of the last message from the gimbal, 0 before the first one
+    std::atomic<uint64_t> last_arrival{0};
+    // Number of messages received from the gimbal
+    std::atomic<uint64_t> arrivals{0};
+    // Number of gaps longer than STREAM_GAP_PERIODS periods of the requested rate
+    std::atomic<uint64_t> gaps{0};
+    // Time stamp of the gimbal in microseconds of the last message picked up from the SDK, 0 before the first one
+    std::atomic<uint64_t> last_device_stamp{0};
+    // Number of messages replaced in the SDK by a newer one before they were picked up
+    std::atomic<uint64_t> missed{0};
+    // Number of published messages
+    std::atomic<uint64_t> published{0};
+    // Number of publications skipped because no newer message arrived
+    std::atomic<uint64_t> duplicates{0};
+    // Number of messages dropped because the queue was full
+    std::atomic<uint64_t> overflows{0};
+    // Time from the SDK receiving a message until the watcher picked it up, with direct telemetry from the read until it was decoded
+    LatencyHistogram pickup_latency;
+    // Time a sample waited until the publishing side took it
+    LatencyHistogram queue_latency;
+    // Time spent converting a sample into its ROS messages
+    LatencyHistogram conversion_time;
+    // Time spent in the publish calls
+    LatencyHistogram publish_time;
+};
+
+// A message of the SDK together with its receive time stamp
+template<typename T>
+struct Sample
+{
+    uint64_t stamp;
+    T message;
+    // Monotonic time the sample was taken from the SDK
+    int64_t pickup_time;
+};
+
+typedef Sample<mavlink_raw_imu_t> RawImuSample;
+typedef Sample<mavlink_mount_status_t> MountStatusSample;
+typedef Sample<mavlink_mount_orientation_t> MountOrientationSample;
+
+// Latest message of every telemetry stream together with its receive time stamp
+struct GimbalSnapshot
+{
+    Time_Stamps stamps;
+    mavlink_raw_imu_t raw_imu;
+    mavlink_mount_status_t mount_status;
+    mavlink_mount_orientation_t mount_orientation;
+};
+
+// Angles of a move command in degrees, or angular rates in degrees per second
+struct GimbalCommand
+{
+    float tilt = 0.0f;
+    float roll = 0.0f;
+    float pan = 0.0f;
+    // Whether the axes are rate controlled
+    bool rate = false;
+    // Monotonic time the command was submitted
+    int64_t submit_time;
+};
+
+typedef actionlib::ActionServer<ros_gremsy::PointGimbalAction> PointGimbalServer;
+typedef std::shared_ptr<const ros_gremsy::ROSGremsyConfig> ConfigConstPtr;
+
 class GimbalNode
 {
 public:
     // Params: (public node handler (for e.g. callbacks), private node handle (for e.g. dynamic reconfigure))
+    // Sets up the gimbal and starts publishing, the callbacks are served by an executor of its own
     GimbalNode(ros::NodeHandle nh, ros::NodeHandle pnh);
+    // Params: (public node handler, private node handle, executor shared with other gimbals)
+    // The callbacks are served once the caller started the executor, it has to be stopped before the node is destroyed
+    GimbalNode(ros::NodeHandle nh, ros::NodeHandle pnh, std::shared_ptr<GimbalExecutor> executor);
+    ~GimbalNode();
+    // Returns the latest telemetry, each message matches its time stamp. Never blocks the thread receiving the telemetry.
+    GimbalSnapshot getSnapshot() const;
 private:
     // Dynamic reconfigure callback
     void reconfigureCallback(ros_gremsy::ROSGremsyConfig &config, uint32_t level);
+    // Snapshot of the current config, which stays unchanged while it is used
+    ConfigConstPtr currentConfig() const;
+    // Timer which advances the startup of the gimbal one step at a time
+    void initTimerCallback(const ros::TimerEvent& event);
+    // Sets the gimbal and axis modes from the current config
+    void configureGimbal();
+    // Sets the input and stabilization mode of each axis, rate control overrides the configured input modes
+    void configureAxes(bool rate_control);
+    // Tells the gimbal how often to send each telemetry stream
+    void requestStreamRates();
+    // Sends MAV_CMD_SET_MESSAGE_INTERVAL for a single message, a rate of 0 restores the default
+    void requestMessageInterval(uint32_t message_id, double rate);
+    // Called whenever a subscriber connects to or disconnects from one of the telemetry topics
+    void subscribersChangedCallback(const ros::SingleSubscriberPublisher& publisher);
+    // Determines which streams have consumers, returns true if any of them changed
+    bool updateStreamDemand();
+    // Updates the stream demand and requests the rates of changed streams once the gimbal is streaming
+    void applyStreamDemand();
+    // Updates the startup state and publishes it on the status topic
+    void setInitState(uint8_t state, const std::string& message);
+    // Human readable name of a startup state
+    std::string initStateToString(uint8_t state);
     // Timer which checks for new infomation regarding the gimbal
     void gimbalStateTimerCallback(const ros::TimerEvent& event);
+    // Watches the SDK time stamps and collects every new message
+    void sampleWatcherLoop();
+    // Publish the queued samples of all streams
+    void drainSampleQueues();
+    // Counts a message received from the gimbal and detects gaps of the stream, called by the receiving thread
+    void trackArrival(StreamState& stream, uint64_t stamp, double requested_rate);
+    // Params: (stream, time stamp of the gimbal in microseconds, requested rate of the stream)
+    // Counts the messages the gimbal sent in between the ones picked up from the SDK
+    void trackMissed(StreamState& stream, uint64_t device_stamp, double requested_rate);
+    // Detects a silent link, requests a reconnect and resumes the gimbal once the link is back
+    void linkWatchdogCallback(const ros::TimerEvent& event);
+    // Reports the link quality
+    void linkDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+    // Publish a sample directly in event driven mode or queue it for the timer
+    void dispatchImu(const RawImuSample& sample);
+    void dispatchEncoder(const MountStatusSample& sample);
+    void dispatchMountOrientation(const MountOrientationSample& sample);
+    // Called by the bridge for every packet of the gimbal, returns true for the telemetry which bypasses the SDK
+    bool handleTelemetryPacket(const MavlinkPacket& packet);
+    // Appends an encoded message of the SDK to the telemetry log
+    void recordMessage(uint64_t stamp, const mavlink_message_t& message);
+    // Publish the latest samples cached by the SDK
+    void publishLatestSamples();
+    // Publish the latest sample of every stream in one message once a new encoder and IMU sample arrived
+    void publishGimbalState();
+    // Publish a sample of a single stream if it has not been published yet
+    void publishImu(const RawImuSample& sample);
+    void publishEncoder(const MountStatusSample& sample);
+    void publishMountOrientation(const MountOrientationSample& sample);
+    // Broadcasts the camera orientation with local and global yaw as transforms
+    void broadcastMountTransforms(
+        const ros::Time& stamp,
+        const geometry_msgs::Quaternion& local_yaw,
+        const geometry_msgs::Quaternion& global_yaw);
+    // Adds an IMU message to the current batch and publishes the batch once it is complete
+    void batchImu(const sensor_msgs::Imu& imu_message);
+    // Returns true if the message with the given time stamp is newer than the last published one
+    bool claimSample(StreamState& stream, uint64_t stamp);
+    // Reports the per stream statistics
+    void telemetryDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+    // Periodically publishes the diagnostics
+    void diagnosticsTimerCallback(const ros::TimerEvent& event);
     // Calback to set a new gimbal position
     void setGoalsCallback(geometry_msgs::Vector3Stamped message);
-    // Converts
-    sensor_msgs::Imu convertImuMavlinkMessageToROSMessage(mavlink_raw_imu_t message);
+    // Calback to set new angular rates of the gimbal
+    void setRateGoalsCallback(geometry_msgs::Vector3Stamped message);
+    // Callback to start a new trajectory, replacing the active one
+    void trajectoryCallback(const ros_gremsy::GimbalTrajectoryConstPtr& message);
+    // Streams the interpolated trajectory to the gimbal at the trajectory rate
+    void trajectoryTimerCallback(const ros::TimerEvent& event);
+    // Accepts a goal of the point action and sends it, replacing the active one
+    void pointGoalCallback(PointGimbalServer::GoalHandle goal_handle);
+    // Cancels the active goal of the point action
+    void pointCancelCallback(PointGimbalServer::GoalHandle goal_handle);
+    // Aborts the active goal of the point action once its timeout expired
+    void pointTimeoutCallback(const ros::TimerEvent& event);
+    // Compares an encoder sample with the active goal of the point action, publishes the feedback and the success
+    void updatePointGoal(const geometry_msgs::Vector3Stamped& encoder);
+    // Aborts the active goal of the point action because another command took over
+    void abortPointGoal(const std::string& reason);
+    // Converts angles in rad into a move command and submits it
+    void submitAngles(const geometry_msgs::Vector3& angles);
+    // Hands a command over to the writer thread, replacing a pending one
+    void submitCommand(const GimbalCommand& command);
+    // Sends the latest command to the gimbal, limited to the configured command rate
+    void commandWriterLoop();
+    // Reports the command statistics
+    void commandDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+    // Publishes the pipeline timing statistics of the last period
+    void statsTimerCallback(const ros::TimerEvent& event);
+    // Reports the latest pipeline timing statistics
+    void latencyDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+    // Converts a receive time stamp of the SDK (microseconds since epoch) into a ROS time stamp
+    ros::Time convertSDKTimeStampToROSTime(uint64_t stamp);
     // Maps integer mode
     control_gimbal_axis_input_mode_t convertIntToAxisInputMode(int mode);
     // Maps integer mode
@@ -38,14 +255,145 @@ private:
     Gimbal_Interface* gimbal_interface_;
     // Serial Interface
     Serial_Port* serial_port_;
-    // Current config
-    ros_gremsy::ROSGremsyConfig config_;
+    // Log of the MAVLink frames, declared before the bridge so it is destroyed after the bridge thread stopped
+    TelemetryRecorder recorder_;
+    // Whether the messages are recorded from the SDK, otherwise the bridge records the received frames
+    bool record_sdk_messages_ = false;
+    // Bridges the serial interface of the SDK to UDP or to the serial device for reconnects or direct telemetry
+    LinkBridge link_bridge_;
+    bool link_bridged_ = false;
+    // State of the link watchdog, only written by its timer
+    bool link_watched_ = false;
+    std::atomic<bool> link_lost_{false};
+    uint64_t link_lost_stamp_ = 0, last_reconnect_request_ = 0;
+    std::atomic<uint64_t> link_losses_{0}, link_recoveries_{0};
+    // After a recovery the startup waits for a heartbeat newer than this wall clock time in microseconds
+    std::atomic<uint64_t> resume_stamp_{0};
+    // Sequence number of the last packet from the gimbal and the packets missing in between, with a bridged link
+    uint8_t link_sequence_ = 0;
+    bool link_sequence_valid_ = false;
+    std::atomic<uint64_t> link_packets_lost_{0};
+    // Counters at the last link diagnostics, to report rates
+    ros::WallTime last_link_diagnostics_;
+    uint64_t last_link_packets_ = 0, last_imu_arrivals_ = 0, last_encoder_arrivals_ = 0, last_mount_orientation_arrivals_ = 0;
+    // Set once the streams are set up, afterwards the bridge hands the telemetry to the node
+    std::atomic<bool> direct_telemetry_ready_{false};
+    // Receive time stamp of the last sample handed over by the bridge
+    uint64_t last_direct_stamp_ = 0;
+    // Current config, replaced as a whole on reconfigure. Every callback and thread works on the snapshot
+    // returned by currentConfig(), so it never sees a config which is changed concurrently.
+    ConfigConstPtr config_;
+    mutable std::mutex config_mutex_;
+    // Scheduling of the threads reading the link, writing the commands and collecting the telemetry
+    ThreadScheduling serial_scheduling_, command_scheduling_, telemetry_scheduling_;
+    // Callback queues and spinners, either owned by this node or shared with other gimbals
+    bool owns_executor_;
+    std::shared_ptr<GimbalExecutor> executor_;
+    dynamic_reconfigure::Server<ros_gremsy::ROSGremsyConfig> reconfigure_server_;
+    // Timers
+    ros::Timer init_timer_, state_timer_, diagnostics_timer_, stats_timer_, trajectory_timer_, point_timer_, link_watchdog_timer_;
+    // Startup state, one of the ros_gremsy::GimbalStatus constants
+    std::atomic<uint8_t> init_state_{ros_gremsy::GimbalStatus::CONNECTING};
+    // Wall time in seconds the startup began, restarted by the link watchdog
+    std::atomic<double> init_start_{0.0};
+    // Set by the start thread once the SDK is connected, shared because the thread is detached
+    std::shared_ptr<std::atomic<bool>> sdk_started_;
     // Publishers
     ros::Publisher
         imu_pub,
+        imu_batch_pub,
+        gimbal_state_pub,
         encoder_pub,
+        encoder_velocity_pub,
         mount_orientation_incl_global_yaw,
-        mount_orientation_incl_local_yaw;
+        mount_orientation_incl_local_yaw,
+        status_pub,
+        stats_pub,
+        tf_pub;
     // Subscribers
-    ros::Subscriber gimbal_goal_sub;
+    ros::Subscriber gimbal_goal_sub, gimbal_rate_goal_sub, gimbal_trajectory_sub;
+    // Diagnostics
+    diagnostic_updater::Updater diagnostics_;
+    // Telemetry streams
+    StreamState imu_stream_, encoder_stream_, mount_orientation_stream_;
+    // Latest telemetry, written by the sample watcher or the bridge
+    Seqlock<GimbalSnapshot> snapshot_;
+    // Copy of the snapshot owned by the writing thread, the streams are updated one at a time
+    GimbalSnapshot writer_snapshot_{};
+    // Recycled messages for each publisher
+    MessagePool<sensor_msgs::Imu> imu_pool_;
+    MessagePool<ros_gremsy::ImuBatch> imu_batch_pool_;
+    MessagePool<geometry_msgs::Vector3Stamped> encoder_pool_, encoder_velocity_pool_;
+    MessagePool<geometry_msgs::Quaternion> mount_orientation_global_pool_, mount_orientation_local_pool_;
+    MessagePool<ros_gremsy::GimbalState> gimbal_state_pool_;
+    // Latest sample of every stream, published with every pair of a new encoder and IMU sample
+    ros_gremsy::GimbalState gimbal_state_;
+    bool gimbal_state_imu_ = false, gimbal_state_encoder_ = false;
+    std::mutex gimbal_state_mutex_;
+    // IMU samples accumulated for the next batch
+    ros_gremsy::ImuBatchPtr imu_batch_;
+    std::mutex imu_batch_mutex_;
+    // Velocity of the axes estimated from the encoder angles
+    VelocityEstimator velocity_estimator_;
+    std::mutex velocity_estimator_mutex_;
+    // Calibration, filtering and orientation estimation of the IMU
+    ImuFilter imu_filter_;
+    std::mutex imu_filter_mutex_;
+    // Maps the IMU and mount orientation time stamps of the gimbal onto the ROS clock
+    ClockSync imu_clock_, mount_orientation_clock_;
+    // Mount orientation transforms, the frame ids are set on reconfigure. Published on /tf like a
+    // tf2_ros::TransformBroadcaster does, but from recycled messages.
+    std::vector<geometry_msgs::TransformStamped> mount_transforms_;
+    MessagePool<tf2_msgs::TFMessage> tf_pool_;
+    std::mutex mount_transforms_mutex_;
+    // Samples collected by the watcher until they are published by the timer
+    SPSCQueue<RawImuSample> imu_queue_;
+    SPSCQueue<MountStatusSample> mount_status_queue_;
+    SPSCQueue<MountOrientationSample> mount_orientation_queue_;
+    // Collects new samples from the SDK and publishes them directly in event driven mode
+    std::thread sample_watcher_;
+    std::atomic<bool> sample_watcher_running_{false};
+    // Timing of the command path
+    LatencyHistogram command_queue_latency_, command_write_time_;
+    // Statistics of the last period, kept for the diagnostics
+    ros_gremsy::PipelineStats last_stats_;
+    std::mutex stats_mutex_;
+    // Latest command which has not been sent yet, guarded by the command mutex
+    GimbalCommand pending_command_;
+    bool command_pending_ = false;
+    uint64_t commands_received_ = 0, commands_sent_ = 0, commands_coalesced_ = 0, rate_stops_ = 0;
+    // Whether the axes are currently switched to rate control and the gimbal is turning
+    bool rate_control_ = false, rate_moving_ = false;
+    // Reconfigured modes which have not been sent yet, guarded by the command mutex
+    bool gimbal_mode_changed_ = false, axes_changed_ = false;
+    // The gimbal is stopped if no rate goal arrives until then
+    std::chrono::steady_clock::time_point rate_deadline_;
+    std::mutex command_mutex_;
+    std::condition_variable command_cv_;
+    // Sends the commands to the gimbal
+    std::thread command_writer_;
+    bool command_writer_running_ = false;
+    // Active trajectory, sampled by the trajectory timer
+    Trajectory trajectory_;
+    uint64_t trajectories_received_ = 0;
+    std::mutex trajectory_mutex_;
+    // Serves the point action, its goals are tracked on the encoder samples
+    std::unique_ptr<PointGimbalServer> point_server_;
+    // Active goal of the point action, guarded by the point mutex. The flag is read without the lock by the encoder path.
+    std::atomic<bool> point_active_{false};
+    PointGimbalServer::GoalHandle point_goal_;
+    geometry_msgs::Vector3 point_target_;
+    double point_tolerance_ = 0.0;
+    // Time the goal was accepted, earlier encoder samples are ignored
+    ros::Time point_start_;
+    // Time the goal is aborted, zero without timeout
+    ros::Time point_deadline_;
+    // Time of the first encoder sample within the tolerance, zero while outside of it
+    ros::Time point_settled_since_;
+    // Latest feedback, also reported as result when the goal ends
+    ros_gremsy::PointGimbalFeedback point_feedback_;
+    uint64_t point_goals_received_ = 0, point_goals_succeeded_ = 0, point_goals_aborted_ = 0, point_goals_canceled_ = 0;
+    std::mutex point_mutex_;
+    // Set by the watcher after each publish, tells the fallback timer that the event path is alive
+    std::atomic<bool> event_published_{false};
 };
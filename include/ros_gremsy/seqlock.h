@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Sequence lock for a single writer thread and any number of readers.
+// The writer never waits for a reader, readers retry until they copied
+// the value without the writer changing it in the meantime.
+template<typename T>
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "The value is copied byte wise");
+
+public:
+    Seqlock()
+    {
+        memset(&value_, 0, sizeof(T));
+    }
+
+    // Called by the writer, replaces the value
+    void store(const T& value)
+    {
+        const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        // An odd sequence tells the readers that the value is being written
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&value_, &value, sizeof(T));
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Returns a consistent copy of the value
+    T load() const
+    {
+        T value;
+        uint64_t before, after;
+        do
+        {
+            before = sequence_.load(std::memory_order_acquire);
+            memcpy(&value, &value_, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence_.load(std::memory_order_relaxed);
+        }
+        while((before & 1) || before != after);
+        return value;
+    }
+
+    // Number of stores so far
+    uint64_t version() const
+    {
+        return sequence_.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    alignas(64) std::atomic<uint64_t> sequence_{0};
+    T value_;
+};
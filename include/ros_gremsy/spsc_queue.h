@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// The capacity is rounded up to the next power of two.
+template<typename T>
+class SPSCQueue
+{
+public:
+    explicit SPSCQueue(size_t capacity = 64)
+    {
+        resize(capacity);
+    }
+
+    // Changes the capacity and drops all queued items, must not be called concurrently to push or pop
+    void resize(size_t capacity)
+    {
+        size_t size = 2;
+        while(size < capacity)
+        {
+            size <<= 1;
+        }
+        buffer_.assign(size, T());
+        mask_ = size - 1;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    // Called by the producer, returns false if the queue is full
+    bool push(const T& item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail - head_.load(std::memory_order_acquire) > mask_)
+        {
+            return false;
+        }
+        buffer_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Called by the consumer, returns false if the queue is empty
+    bool pop(T& item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if(head == tail_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of queued items, only a snapshot if called concurrently
+    size_t size() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_;
+    // Next item to pop, only written by the consumer
+    alignas(64) std::atomic<size_t> head_{0};
+    // Next free slot, only written by the producer
+    alignas(64) std::atomic<size_t> tail_{0};
+};
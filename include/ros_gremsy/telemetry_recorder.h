@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Telemetry log files. A file starts with a TelemetryLogHeader followed by records, each one a
+// TelemetryRecordHeader and the complete MAVLink frame padded to 8 bytes. The hardware time stamps
+// are part of the frames, the records add the receive time stamp and the ROS time of the node.
+// A record with zero length (the unwritten, zero filled rest of a file) ends the log.
+
+#define TELEMETRY_LOG_MAGIC "GRMSYTLM"
+#define TELEMETRY_LOG_VERSION 1
+
+struct TelemetryLogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    // Wall clock time in microseconds the file was created
+    uint64_t created;
+    uint64_t reserved;
+};
+
+struct TelemetryRecordHeader
+{
+    // Length of the frame in bytes
+    uint32_t length;
+    uint32_t reserved;
+    // Receive time stamp of the frame in microseconds since epoch, the clock of the SDK and the bridge
+    uint64_t receive_stamp;
+    // ROS time in nanoseconds when the frame was recorded
+    int64_t ros_time;
+};
+
+// Appends MAVLink frames to memory mapped files of a fixed size. Once a file is full the recorder
+// switches to the next one, which a background thread has already created and mapped, so recording
+// never waits for the file system. Finished files are truncated to their content and the oldest
+// ones are removed beyond the maximum number of files.
+class TelemetryRecorder
+{
+public:
+    TelemetryRecorder() = default;
+    ~TelemetryRecorder();
+    // Params: (path prefix of the files, size of each file in bytes, number of files to keep, 0 keeps all)
+    // The files are named <prefix>_<start time>_<index>.tlm. Returns false and describes the failure in error.
+    bool start(const std::string& prefix, size_t file_size, int max_files, std::string& error);
+    // Finishes the current file
+    void stop();
+    bool active() const { return active_; }
+    // Params: (receive time stamp in microseconds, ROS time in nanoseconds, frame)
+    // Appends a frame, has to be called from a single thread. Frames are dropped while no file is ready.
+    void record(uint64_t receive_stamp, int64_t ros_time, const uint8_t* frame, size_t length);
+
+    // Number of recorded and dropped frames and of the files written so far
+    uint64_t records() const { return records_; }
+    uint64_t dropped() const { return dropped_; }
+    uint64_t files() const { return files_; }
+private:
+    struct MappedFile
+    {
+        std::string path;
+        int fd = -1;
+        uint8_t* data = nullptr;
+        size_t used = 0;
+    };
+
+    // Creates, maps and initializes the next file
+    bool openFile(MappedFile& file, std::string& error);
+    // Unmaps the file and truncates it to its content
+    void closeFile(MappedFile& file);
+    // Switches to the prepared file, returns false if it is not ready yet
+    bool rotate();
+    // Prepares the next file, finishes full ones and removes old ones
+    void maintenanceLoop();
+
+    std::string prefix_;
+    size_t file_size_ = 0;
+    int max_files_ = 0;
+    int file_index_ = 0;
+    std::atomic<bool> active_{false};
+    // Written by the recording thread only
+    MappedFile current_;
+    // Handed over between the recording and the maintenance thread, guarded by the mutex
+    MappedFile next_, finished_;
+    bool next_ready_ = false, finished_pending_ = false;
+    // Paths of the finished files, oldest first, only used by the maintenance thread
+    std::deque<std::string> finished_paths_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread maintenance_thread_;
+    bool maintenance_running_ = false;
+    std::atomic<uint64_t> records_{0}, dropped_{0}, files_{0};
+};
+
+// Reads a telemetry log file written by the TelemetryRecorder
+class TelemetryLogReader
+{
+public:
+    TelemetryLogReader() = default;
+    ~TelemetryLogReader();
+    // Maps the file, returns false and describes the failure in error
+    bool open(const std::string& path, std::string& error);
+    void close();
+    // Returns the next record and its frame, which stays valid until the reader is closed. False at the end of the log.
+    bool next(TelemetryRecordHeader& record, const uint8_t*& frame);
+private:
+    int fd_ = -1;
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+};
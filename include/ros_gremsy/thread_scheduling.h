@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Real-time scheduling of the threads on the latency critical path. Threads apply their
+// scheduling themselves when they start, threads they create (e.g. the read and write
+// threads of the SDK) inherit it.
+
+struct ThreadScheduling
+{
+    // SCHED_FIFO priority from 1 to 99, 0 keeps the normal scheduler
+    int priority = 0;
+    // CPUs the thread may run on, empty keeps the affinity of the process
+    std::vector<int> cpus;
+};
+
+// Params: (list of CPUs like "2,3" or "0-3,6", an empty list keeps the affinity, parsed CPUs)
+// Returns false and describes the malformed part in error
+bool parseCpuList(const std::string& list, std::vector<int>& cpus, std::string& error);
+// Applies the scheduling to the calling thread. Everything which can be set is set,
+// returns false and describes the failures in error, e.g. a missing CAP_SYS_NICE.
+bool applyThreadScheduling(const ThreadScheduling& scheduling, std::string& error);
+// Params: (scheduling, name of the thread in the log)
+// Applies the scheduling to the calling thread, warns about failures and logs the effective scheduling
+void applyThreadScheduling(const ThreadScheduling& scheduling, const std::string& name);
+// Effective scheduling of the calling thread, e.g. "SCHED_FIFO priority 80 on CPUs 2-3"
+std::string describeThreadScheduling();
+// Locks all current and future pages of the process into memory, so page faults never stall the threads.
+// Returns false and describes the failure in error.
+bool lockProcessMemory(std::string& error);
@@ -0,0 +1,36 @@
+#pragma once
+#include <ros/ros.h>
+#include <geometry_msgs/Vector3.h>
+#include <ros_gremsy/GimbalTrajectory.h>
+#include <string>
+#include <vector>
+
+// Interpolates the waypoints of a gimbal trajectory by a cubic Hermite spline.
+// The velocity at each inner waypoint follows from its neighbours (Catmull-Rom),
+// the gimbal starts from and comes to rest at the first and last waypoint.
+class Trajectory
+{
+public:
+    // Replaces the trajectory, returns false and leaves it unchanged if the waypoints are invalid
+    bool set(const ros_gremsy::GimbalTrajectory& trajectory, const ros::Time& receive_time, std::string& error);
+    // Drops the trajectory
+    void clear();
+    // Returns true while the trajectory is active, i.e. it has been set and its last waypoint is not reached yet
+    bool active() const;
+    // Interpolates the angles at the given time, returns false once the last waypoint has been passed.
+    // Before the start the first waypoint is returned.
+    bool sample(const ros::Time& time, geometry_msgs::Vector3& angles);
+private:
+    struct Knot
+    {
+        // Seconds since the start of the trajectory
+        double time;
+        double position[3];
+        double velocity[3];
+    };
+
+    std::vector<Knot> knots_;
+    ros::Time start_;
+    // Index of the segment used by the last sample, samples are taken in order
+    size_t segment_ = 0;
+};
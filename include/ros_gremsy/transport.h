@@ -0,0 +1,104 @@
+#pragma once
+#include <ros_gremsy/mavlink_framer.h>
+#include <ros_gremsy/thread_scheduling.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <netinet/in.h>
+
+// Transports of the link to the gimbal. The SDK only talks to a serial device, so the serial
+// transport either tunes the device the SDK opened or, like the UDP transport, is bridged
+// to a pseudo terminal which the SDK opens instead of a serial port.
+
+// Configures an open serial device for low latency: the baud rate (including the Linux rates above
+// 921600), blocking reads which return with the first byte, ASYNC_LOW_LATENCY and, for FTDI adapters,
+// their latency timer in ms (0 keeps it). Returns false and describes the first failure in error.
+bool configureLowLatencySerial(const std::string& device, int baudrate, int ftdi_latency_timer, std::string& error);
+
+// Forwards MAVLink between the link to the gimbal (a serial device or a UDP socket) and a pseudo terminal.
+// With a packet handler the packets from the gimbal are framed by the bridge, the ones taken by the
+// handler are not forwarded, so the SDK only parses the remaining ones. A serial device which fails,
+// e.g. an unplugged USB adapter, is reopened by the bridge while the SDK keeps the pseudo terminal.
+class LinkBridge
+{
+public:
+    // Returns true if the packet has been consumed and must not be forwarded to the SDK
+    typedef std::function<bool(const MavlinkPacket&)> PacketHandler;
+
+    LinkBridge() = default;
+    ~LinkBridge();
+    // Params: (called from the bridge thread for every packet from the gimbal)
+    // Has to be set before the bridge is started
+    void setPacketHandler(PacketHandler handler);
+    // Params: (time in seconds between the attempts to reopen a failed serial device)
+    // Has to be set before the bridge is started
+    void setReconnectInterval(double interval);
+    // Params: (scheduling of the forwarding thread, which reads the link)
+    // Has to be set before the bridge is started
+    void setThreadScheduling(const ThreadScheduling& scheduling);
+    // Params: (serial device, baudrate, latency timer of FTDI adapters in ms, 0 keeps it)
+    // Opens the device configured for low latency, returns false and describes the failure in error.
+    bool startSerial(const std::string& device, int baudrate, int ftdi_latency_timer, std::string& error);
+    // Params: (local port to receive from, remote host and port to send to)
+    // Without a remote host the bridge replies to the sender of the last datagram.
+    // Returns false and describes the failure in error.
+    bool startUdp(int local_port, const std::string& remote_host, int remote_port, std::string& error);
+    // Stops forwarding and closes the link and the pseudo terminal
+    void stop();
+    // Closes the serial device and opens it again, e.g. because it stopped delivering data. Ignored for UDP.
+    void requestReconnect();
+    // Whether the link is open
+    bool connected() const;
+    // Number of times the serial device failed or was closed on request, and was opened again
+    uint64_t disconnects() const;
+    uint64_t reconnects() const;
+    // Pseudo terminal the SDK has to open
+    const std::string& device() const;
+    // Number of reads from and writes to the link
+    uint64_t received() const;
+    uint64_t sent() const;
+    // Number of packets or reads from the link which could not be passed on to the SDK completely
+    uint64_t forward_failures() const;
+    // Statistics of the framer, all zero without a packet handler
+    uint64_t packets() const;
+    uint64_t consumed() const;
+    uint64_t bad_checksums() const;
+    uint64_t unknown_messages() const;
+private:
+    // Creates the pseudo terminal for the SDK
+    bool openPseudoTerminal(std::string& error);
+    // Opens and configures the serial device, returns false and describes the failure in error
+    bool openSerialLink(std::string& error);
+    // Closes the serial device, the forwarding thread opens it again after the reconnect interval
+    void closeSerialLink(const std::string& reason);
+    // Starts the forwarding thread
+    void startForwarding();
+    // Forwards data in both directions until stopped
+    void forwardLoop();
+    // Forwards a packet from the gimbal unless the handler consumes it
+    void handlePacket(const MavlinkPacket& packet);
+    // Sends data from the SDK to the gimbal
+    void sendToLink(const uint8_t* data, size_t length);
+
+    int master_fd_ = -1, slave_fd_ = -1, link_fd_ = -1;
+    bool udp_ = false;
+    std::string device_;
+    // Settings of the serial device, kept to reopen it
+    std::string serial_device_;
+    int baudrate_ = 0, ftdi_latency_timer_ = 0;
+    double reconnect_interval_ = 0.2;
+    ThreadScheduling scheduling_;
+    std::chrono::steady_clock::time_point next_reconnect_;
+    std::atomic<bool> connected_{false}, reconnect_requested_{false};
+    std::atomic<uint64_t> disconnects_{0}, reconnects_{0};
+    sockaddr_in remote_address_{};
+    bool remote_known_ = false;
+    PacketHandler packet_handler_;
+    std::unique_ptr<MavlinkFramer> framer_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> received_{0}, sent_{0}, consumed_{0}, forward_failures_{0};
+};
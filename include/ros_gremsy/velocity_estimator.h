@@ -0,0 +1,38 @@
+#pragma once
+#include <ros/ros.h>
+
+// Estimates the angular velocity of the three gimbal axes from consecutive encoder angles,
+// either by finite differences or by a constant velocity Kalman filter per axis.
+// Differences are wrapped, so an axis turning over +-pi does not cause a spike.
+class VelocityEstimator
+{
+public:
+    static const int FINITE_DIFFERENCE = 0;
+    static const int KALMAN = 1;
+
+    struct Parameters
+    {
+        int method = FINITE_DIFFERENCE;
+        // Spectral density of the angular acceleration in rad^2/s^3, i.e. how fast the velocity may change
+        double process_noise = 1.0;
+        // Standard deviation of the encoder angles in rad
+        double measurement_noise = 0.001;
+    };
+
+    // Applies new parameters, a changed method starts the estimation from scratch
+    void configure(const Parameters& parameters);
+    // Drops the estimated state
+    void reset();
+    // Params: (sample time, angles around x, y and z in rad, estimated velocities in rad/s)
+    // Returns false while no estimate is available yet
+    bool update(const ros::Time& stamp, const double angles[3], double velocity[3]);
+private:
+    Parameters parameters_;
+    ros::Time last_stamp_;
+    size_t samples_ = 0;
+    // Last angles for the finite differences, estimated angles for the Kalman filter
+    double angle_[3] = {};
+    double velocity_[3] = {};
+    // Covariance of angle and velocity for each axis
+    double covariance_[3][3] = {};
+};
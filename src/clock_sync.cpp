@@ -0,0 +1,117 @@
+#include <ros_gremsy/clock_sync.h>
+
+ClockSync::ClockSync(size_t window_size) : window_size_(std::max<size_t>(window_size, 2))
+{
+    samples_.reserve(window_size_);
+    reset();
+}
+
+ros::Time ClockSync::update(uint64_t device_usec, const ros::Time& receive_time)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // The device clock jumped backwards, most likely the gimbal rebooted
+    if(!samples_.empty() && device_usec < last_device_usec_)
+    {
+        ROS_WARN("Gimbal clock jumped backwards, resetting the time synchronization");
+        clear();
+    }
+
+    if(samples_.empty())
+    {
+        device_origin_ = device_usec;
+        receive_origin_ = receive_time;
+    }
+    last_device_usec_ = device_usec;
+
+    std::pair<double, double> sample(
+        (device_usec - device_origin_) * 1e-6,
+        (receive_time - receive_origin_).toSec());
+
+    // Replace the oldest sample once the window is full
+    if(samples_.size() < window_size_)
+    {
+        samples_.push_back(sample);
+    }
+    else
+    {
+        samples_[next_sample_] = sample;
+        next_sample_ = (next_sample_ + 1) % window_size_;
+    }
+
+    // A single sample does not allow an estimate of the drift
+    if(samples_.size() < 2)
+    {
+        return receive_time;
+    }
+
+    fit();
+    return map(device_usec);
+}
+
+ros::Time ClockSync::toROSTime(uint64_t device_usec) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return map(device_usec);
+}
+
+void ClockSync::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    clear();
+}
+
+void ClockSync::clear()
+{
+    samples_.clear();
+    next_sample_ = 0;
+    device_origin_ = 0;
+    receive_origin_ = ros::Time();
+    last_device_usec_ = 0;
+    offset_ = 0.0;
+    drift_ = 1.0;
+}
+
+void ClockSync::setWindowSize(size_t window_size)
+{
+    window_size = std::max<size_t>(window_size, 2);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(window_size == window_size_)
+    {
+        return;
+    }
+    clear();
+    window_size_ = window_size;
+    samples_.reserve(window_size_);
+}
+
+void ClockSync::fit()
+{
+    // Least squares fit with centered values to keep the precision for long runs
+    double mean_device = 0.0, mean_receive = 0.0;
+    for(const auto& sample : samples_)
+    {
+        mean_device += sample.first;
+        mean_receive += sample.second;
+    }
+    mean_device /= samples_.size();
+    mean_receive /= samples_.size();
+
+    double covariance = 0.0, variance = 0.0;
+    for(const auto& sample : samples_)
+    {
+        double device = sample.first - mean_device;
+        covariance += device * (sample.second - mean_receive);
+        variance += device * device;
+    }
+
+    // All samples have the same device time stamp, keep the nominal drift
+    drift_ = variance > 0.0 ? covariance / variance : 1.0;
+    offset_ = mean_receive - drift_ * mean_device;
+}
+
+ros::Time ClockSync::map(uint64_t device_usec) const
+{
+    double device = (static_cast<double>(device_usec) - static_cast<double>(device_origin_)) * 1e-6;
+    return receive_origin_ + ros::Duration(offset_ + drift_ * device);
+}
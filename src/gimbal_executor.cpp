@@ -0,0 +1,27 @@
+#include <ros_gremsy/gimbal_executor.h>
+
+GimbalExecutor::~GimbalExecutor()
+{
+    stop();
+}
+
+void GimbalExecutor::start(int command_threads, int telemetry_threads)
+{
+    // Commands and telemetry are served by separate spinners, so neither of them waits for the other
+    command_spinner_.reset(new ros::AsyncSpinner(std::max(command_threads, 1), &command_queue));
+    telemetry_spinner_.reset(new ros::AsyncSpinner(std::max(telemetry_threads, 1), &telemetry_queue));
+    reconfigure_spinner_.reset(new ros::AsyncSpinner(1, &reconfigure_queue));
+    command_spinner_->start();
+    telemetry_spinner_->start();
+    reconfigure_spinner_->start();
+}
+
+void GimbalExecutor::stop()
+{
+    if(command_spinner_)
+    {
+        command_spinner_->stop();
+        telemetry_spinner_->stop();
+        reconfigure_spinner_->stop();
+    }
+}
@@ -0,0 +1,14 @@
+#include <ros_gremsy/ros_gremsy.h>
+
+int main(int argc, char **argv)
+{
+    // Init
+    ros::init(argc, argv, "ros_gremsy");
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+    GimbalNode n(nh, pnh);
+
+    ros::spin();
+
+    return 0;
+}
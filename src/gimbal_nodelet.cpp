@@ -0,0 +1,23 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros_gremsy/ros_gremsy.h>
+
+namespace ros_gremsy
+{
+
+// Runs the GimbalNode inside a nodelet manager, so subscribers
+// in the same manager receive the messages without serialization
+class GimbalNodelet : public nodelet::Nodelet
+{
+private:
+    void onInit() override
+    {
+        node_.reset(new GimbalNode(getNodeHandle(), getPrivateNodeHandle()));
+    }
+
+    std::unique_ptr<GimbalNode> node_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(ros_gremsy::GimbalNodelet, nodelet::Nodelet)
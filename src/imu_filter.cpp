@@ -0,0 +1,204 @@
+#include <ros_gremsy/imu_filter.h>
+#include <tf2/LinearMath/Vector3.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <cmath>
+
+#define STANDARD_GRAVITY 9.80665
+// Number of sample periods averaged before the filters are designed
+#define RATE_ESTIMATION_SAMPLES 20
+// Relative change of the sample rate after which the filters are designed again
+#define RATE_CHANGE_TOLERANCE 0.1
+// Gaps longer than this reset the estimation in s
+#define MAX_SAMPLE_GAP 1.0
+
+void ImuBiquad::designLowPass(double cutoff, double sample_rate)
+{
+    enabled = cutoff > 0.0 && cutoff < 0.5 * sample_rate;
+    if(!enabled)
+    {
+        return;
+    }
+
+    // Butterworth response, see the audio EQ cookbook by R. Bristow-Johnson
+    double w0 = 2.0 * M_PI * cutoff / sample_rate;
+    double alpha = std::sin(w0) / (2.0 * M_SQRT1_2);
+    double a0 = 1.0 + alpha;
+    b0 = (1.0 - std::cos(w0)) / 2.0 / a0;
+    b1 = (1.0 - std::cos(w0)) / a0;
+    b2 = b0;
+    a1 = -2.0 * std::cos(w0) / a0;
+    a2 = (1.0 - alpha) / a0;
+}
+
+void ImuBiquad::designNotch(double frequency, double bandwidth, double sample_rate)
+{
+    enabled = frequency > 0.0 && bandwidth > 0.0 && frequency < 0.5 * sample_rate;
+    if(!enabled)
+    {
+        return;
+    }
+
+    double w0 = 2.0 * M_PI * frequency / sample_rate;
+    double alpha = std::sin(w0) / (2.0 * frequency / bandwidth);
+    double a0 = 1.0 + alpha;
+    b0 = 1.0 / a0;
+    b1 = -2.0 * std::cos(w0) / a0;
+    b2 = b0;
+    a1 = b1;
+    a2 = (1.0 - alpha) / a0;
+}
+
+void ImuBiquad::apply(double values[AXES])
+{
+    if(!enabled)
+    {
+        return;
+    }
+
+    for(int axis = 0; axis < AXES; axis++)
+    {
+        double x = values[axis];
+        double y = b0 * x + b1 * x1[axis] + b2 * x2[axis] - a1 * y1[axis] - a2 * y2[axis];
+        x2[axis] = x1[axis];
+        x1[axis] = x;
+        y2[axis] = y1[axis];
+        y1[axis] = y;
+        values[axis] = y;
+    }
+}
+
+void ImuBiquad::reset(const double values[AXES])
+{
+    for(int axis = 0; axis < AXES; axis++)
+    {
+        x1[axis] = x2[axis] = y1[axis] = y2[axis] = values[axis];
+    }
+}
+
+void ImuFilter::configure(const Parameters& parameters)
+{
+    parameters_ = parameters;
+    if(design_rate_ > 0.0)
+    {
+        designFilters();
+    }
+}
+
+void ImuFilter::reset()
+{
+    initialized_ = false;
+    design_rate_ = 0.0;
+    mean_period_ = 0.0;
+    period_samples_ = 0;
+    lowpass_.enabled = false;
+    notch_.enabled = false;
+    for(double& bias : gyro_bias_)
+    {
+        bias = 0.0;
+    }
+    orientation_.setValue(0.0, 0.0, 0.0, 1.0);
+}
+
+void ImuFilter::designFilters()
+{
+    lowpass_.designLowPass(parameters_.lowpass_cutoff, design_rate_);
+    notch_.designNotch(parameters_.notch_frequency, parameters_.notch_bandwidth, design_rate_);
+}
+
+void ImuFilter::update(sensor_msgs::Imu& imu)
+{
+    double values[ImuBiquad::AXES] = {
+        imu.linear_acceleration.x * parameters_.accel_scale,
+        imu.linear_acceleration.y * parameters_.accel_scale,
+        imu.linear_acceleration.z * parameters_.accel_scale,
+        imu.angular_velocity.x * parameters_.gyro_scale,
+        imu.angular_velocity.y * parameters_.gyro_scale,
+        imu.angular_velocity.z * parameters_.gyro_scale};
+
+    double dt = initialized_ ? (imu.header.stamp - last_stamp_).toSec() : 0.0;
+    if(initialized_ && (dt <= 0.0 || dt > MAX_SAMPLE_GAP))
+    {
+        ROS_WARN_THROTTLE(1.0, "Gap of %.3f s in the IMU data, resetting the IMU filter", dt);
+        reset();
+        dt = 0.0;
+    }
+    last_stamp_ = imu.header.stamp;
+
+    // The filters are designed for the rate the samples actually arrive with
+    if(dt > 0.0)
+    {
+        period_samples_++;
+        mean_period_ += (dt - mean_period_) / std::min<size_t>(period_samples_, RATE_ESTIMATION_SAMPLES);
+        double rate = 1.0 / mean_period_;
+        if(period_samples_ >= RATE_ESTIMATION_SAMPLES &&
+            (design_rate_ == 0.0 || std::abs(rate - design_rate_) > RATE_CHANGE_TOLERANCE * design_rate_))
+        {
+            design_rate_ = rate;
+            designFilters();
+            lowpass_.reset(values);
+            notch_.reset(values);
+        }
+    }
+    lowpass_.apply(values);
+    notch_.apply(values);
+
+    tf2::Vector3 acceleration(values[0], values[1], values[2]);
+    tf2::Vector3 angular_velocity(values[3], values[4], values[5]);
+
+    // While the gimbal rests the gyro only measures its bias
+    bool stationary =
+        angular_velocity.length() < parameters_.stationary_threshold &&
+        std::abs(acceleration.length() - STANDARD_GRAVITY) < 0.1 * STANDARD_GRAVITY;
+    if(stationary && dt > 0.0 && parameters_.bias_time_constant > 0.0)
+    {
+        double weight = std::min(dt / parameters_.bias_time_constant, 1.0);
+        for(int axis = 0; axis < 3; axis++)
+        {
+            gyro_bias_[axis] += (values[3 + axis] - gyro_bias_[axis]) * weight;
+        }
+    }
+    angular_velocity -= tf2::Vector3(gyro_bias_[0], gyro_bias_[1], gyro_bias_[2]);
+
+    if(!initialized_)
+    {
+        // Start from the tilt measured by the accelerometer
+        double roll = std::atan2(acceleration.y(), acceleration.z());
+        double pitch = std::atan2(-acceleration.x(), std::hypot(acceleration.y(), acceleration.z()));
+        orientation_.setRPY(roll, pitch, 0.0);
+        initialized_ = true;
+    }
+    else if(dt > 0.0)
+    {
+        // Complementary filter: the gyro is corrected by the angle between the measured and the
+        // estimated gravity, so the tilt follows the accelerometer with the configured time constant
+        tf2::Vector3 correction(0.0, 0.0, 0.0);
+        if(acceleration.length() > 0.0 && parameters_.orientation_time_constant > 0.0)
+        {
+            tf2::Vector3 estimated_gravity = tf2::quatRotate(orientation_.inverse(), tf2::Vector3(0.0, 0.0, 1.0));
+            correction = acceleration.normalized().cross(estimated_gravity) / parameters_.orientation_time_constant;
+        }
+        tf2::Vector3 rotation = (angular_velocity + correction) * dt;
+        if(rotation.length() > 0.0)
+        {
+            orientation_ *= tf2::Quaternion(rotation.normalized(), rotation.length());
+            orientation_.normalize();
+        }
+    }
+
+    imu.linear_acceleration.x = acceleration.x();
+    imu.linear_acceleration.y = acceleration.y();
+    imu.linear_acceleration.z = acceleration.z();
+    imu.angular_velocity.x = angular_velocity.x();
+    imu.angular_velocity.y = angular_velocity.y();
+    imu.angular_velocity.z = angular_velocity.z();
+    tf2::convert(orientation_, imu.orientation);
+
+    // Diagonal covariances, the yaw is only known from the start of the integration
+    for(int axis = 0; axis < 3; axis++)
+    {
+        imu.linear_acceleration_covariance[axis * 4] = parameters_.accel_noise * parameters_.accel_noise;
+        imu.angular_velocity_covariance[axis * 4] = parameters_.gyro_noise * parameters_.gyro_noise;
+        imu.orientation_covariance[axis * 4] = parameters_.orientation_noise * parameters_.orientation_noise;
+    }
+    imu.orientation_covariance[8] = M_PI * M_PI;
+}
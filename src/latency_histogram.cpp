@@ -0,0 +1,76 @@
+#include <ros_gremsy/latency_histogram.h>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+{
+    for(auto& bucket : buckets_)
+    {
+        bucket = 0;
+    }
+}
+
+void LatencyHistogram::record(int64_t nanoseconds)
+{
+    uint64_t value = nanoseconds > 0 ? nanoseconds : 0;
+
+    size_t bucket = value > 1 ? static_cast<size_t>(std::log2(static_cast<double>(value)) * buckets_per_octave) : 0;
+    if(bucket >= num_buckets)
+    {
+        bucket = num_buckets - 1;
+    }
+
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while(value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed));
+}
+
+LatencyHistogram::Summary LatencyHistogram::collect()
+{
+    std::array<uint64_t, num_buckets> buckets;
+    uint64_t count = 0;
+    for(size_t i = 0; i < num_buckets; i++)
+    {
+        buckets[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+        count += buckets[i];
+    }
+    // Samples recorded during the collection may be split between two periods, which is fine for statistics
+    count_.exchange(0, std::memory_order_relaxed);
+    uint64_t sum = sum_.exchange(0, std::memory_order_relaxed);
+    uint64_t max = max_.exchange(0, std::memory_order_relaxed);
+
+    Summary summary;
+    if(count == 0)
+    {
+        return summary;
+    }
+
+    summary.count = count;
+    summary.mean = sum * 1e-9 / count;
+    summary.max = max * 1e-9;
+
+    // Walk the buckets until the requested share of the samples is covered
+    double* percentiles[] = {&summary.p50, &summary.p90, &summary.p99};
+    const double shares[] = {0.5, 0.9, 0.99};
+    uint64_t covered = 0;
+    size_t next = 0;
+    for(size_t i = 0; i < num_buckets && next < 3; i++)
+    {
+        covered += buckets[i];
+        while(next < 3 && covered >= shares[next] * count)
+        {
+            // The bound of a bucket can exceed the largest sample in it
+            *percentiles[next] = std::min(bucketUpperBound(i) * 1e-9, summary.max);
+            next++;
+        }
+    }
+
+    return summary;
+}
+
+double LatencyHistogram::bucketUpperBound(size_t bucket)
+{
+    return std::exp2(static_cast<double>(bucket + 1) / buckets_per_octave);
+}
@@ -0,0 +1,141 @@
+#include <ros_gremsy/mavlink_framer.h>
+#include <ros_gremsy/latency_histogram.h>
+#include <unistd.h>
+#include "serial_port.h"
+
+// Header lengths including the start byte
+#define MAVLINK1_HEADER_LENGTH 6
+#define MAVLINK2_HEADER_LENGTH 10
+#define MAVLINK_CHECKSUM_LENGTH 2
+#define MAVLINK2_SIGNATURE_LENGTH 13
+#define MAVLINK2_FLAG_SIGNED 0x01
+// Incompatibility flags this framer understands, packets with any other flag can not be framed
+#define MAVLINK2_KNOWN_INCOMPAT_FLAGS MAVLINK2_FLAG_SIGNED
+
+MavlinkFramer::MavlinkFramer(size_t buffer_size, Handler handler) :
+    buffer_(std::max<size_t>(buffer_size, MAVLINK_MAX_PACKET_LEN)),
+    handler_(handler)
+{
+}
+
+ssize_t MavlinkFramer::readFrom(int fd)
+{
+    ssize_t length = read(fd, buffer_.data() + filled_, buffer_.size() - filled_);
+    if(length > 0)
+    {
+        receive_time_ = monotonicNanoseconds();
+        filled_ += length;
+        frame();
+    }
+    return length;
+}
+
+void MavlinkFramer::feed(const uint8_t* data, size_t length)
+{
+    receive_time_ = monotonicNanoseconds();
+    while(length > 0)
+    {
+        size_t copied = std::min(length, buffer_.size() - filled_);
+        memcpy(buffer_.data() + filled_, data, copied);
+        filled_ += copied;
+        data += copied;
+        length -= copied;
+        frame();
+    }
+}
+
+void MavlinkFramer::frame()
+{
+    const uint8_t* buffer = buffer_.data();
+    size_t position = 0;
+
+    while(position < filled_)
+    {
+        uint8_t magic = buffer[position];
+        if(magic != MAVLINK_STX && magic != MAVLINK_STX_MAVLINK1)
+        {
+            position++;
+            skipped_bytes_++;
+            continue;
+        }
+
+        bool mavlink2 = magic == MAVLINK_STX;
+        size_t header_length = mavlink2 ? MAVLINK2_HEADER_LENGTH : MAVLINK1_HEADER_LENGTH;
+        if(position + header_length > filled_)
+        {
+            break;
+        }
+
+        const uint8_t* header = buffer + position;
+        // Only a corrupted packet or data outside of packets sets unknown flags, search from the next byte
+        if(mavlink2 && (header[2] & ~MAVLINK2_KNOWN_INCOMPAT_FLAGS))
+        {
+            position++;
+            skipped_bytes_++;
+            continue;
+        }
+        size_t payload_length = header[1];
+        size_t length = header_length + payload_length + MAVLINK_CHECKSUM_LENGTH;
+        if(mavlink2 && (header[2] & MAVLINK2_FLAG_SIGNED))
+        {
+            length += MAVLINK2_SIGNATURE_LENGTH;
+        }
+
+        // The length of a packet is only trusted once its checksum is verified, which needs the extra crc
+        // of the message. A start byte inside a corrupted packet mostly reads as an unknown message, taking
+        // its length would swallow the valid packets behind it, so the search continues with the next byte.
+        uint32_t message_id = mavlink2 ? header[7] | (header[8] << 8) | (header[9] << 16) : header[5];
+        const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(message_id);
+        if(!entry)
+        {
+            position++;
+            skipped_bytes_++;
+            unknown_messages_++;
+            continue;
+        }
+        if(position + length > filled_)
+        {
+            break;
+        }
+
+        MavlinkPacket packet;
+        if(mavlink2)
+        {
+            packet.sequence = header[4];
+            packet.system_id = header[5];
+            packet.component_id = header[6];
+        }
+        else
+        {
+            packet.sequence = header[2];
+            packet.system_id = header[3];
+            packet.component_id = header[4];
+        }
+        packet.message_id = message_id;
+        packet.payload = header + header_length;
+        packet.payload_length = payload_length;
+        packet.data = header;
+        packet.length = length;
+        packet.receive_time = receive_time_;
+
+        // The checksum covers everything but the start byte and is seeded by the extra crc of the message
+        uint16_t checksum = crc_calculate(header + 1, header_length - 1 + payload_length);
+        crc_accumulate(entry->crc_extra, &checksum);
+        const uint8_t* received = packet.payload + payload_length;
+        if(checksum != (received[0] | (received[1] << 8)))
+        {
+            // Most likely the start byte was part of a corrupted packet, search from the next byte
+            bad_checksums_++;
+            position++;
+            continue;
+        }
+
+        packets_++;
+        handler_(packet);
+        position += length;
+    }
+
+    // Keep the incomplete packet for the next read
+    memmove(buffer_.data(), buffer + position, filled_ - position);
+    filled_ -= position;
+}
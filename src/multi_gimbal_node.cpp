@@ -0,0 +1,40 @@
+#include <ros_gremsy/ros_gremsy.h>
+
+// Serves several gimbals from one process. Each gimbal is configured in its own
+// namespace below the private one and publishes its topics there, while the
+// callbacks of all gimbals are served by a shared executor.
+int main(int argc, char **argv)
+{
+    // Init
+    ros::init(argc, argv, "ros_gremsy");
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    std::vector<std::string> gimbals;
+    if(!pnh.getParam("gimbals", gimbals) || gimbals.empty())
+    {
+        ROS_FATAL("No gimbals configured, set ~gimbals to the list of their namespaces");
+        return 1;
+    }
+
+    int command_threads, telemetry_threads;
+    pnh.param("command_threads", command_threads, 1);
+    pnh.param("telemetry_threads", telemetry_threads, (int) gimbals.size());
+
+    std::shared_ptr<GimbalExecutor> executor = std::make_shared<GimbalExecutor>();
+    std::vector<std::unique_ptr<GimbalNode>> nodes;
+    for(const std::string& gimbal : gimbals)
+    {
+        ROS_INFO("Starting gimbal %s", gimbal.c_str());
+        nodes.emplace_back(new GimbalNode(nh, ros::NodeHandle(pnh, gimbal), executor));
+    }
+    executor->start(command_threads, telemetry_threads);
+
+    ros::spin();
+
+    // The callbacks of all gimbals have to be finished before the first one is destroyed
+    executor->stop();
+    nodes.clear();
+
+    return 0;
+}
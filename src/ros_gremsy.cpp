@@ -1,145 +1,1744 @@
 #include <ros_gremsy/ros_gremsy.h>
 
-GimbalNode::GimbalNode(ros::NodeHandle nh, ros::NodeHandle pnh)
+// Returns a copy of the node handle which puts its callbacks into the given queue
+static ros::NodeHandle withCallbackQueue(ros::NodeHandle nh, ros::CallbackQueue* queue)
+{
+    nh.setCallbackQueue(queue);
+    return nh;
+}
+
+// Path prefix of the telemetry logs if none is configured
+static std::string defaultRecordPrefix()
+{
+    const char* ros_home = getenv("ROS_HOME");
+    const char* home = getenv("HOME");
+    std::string directory = ros_home ? ros_home : std::string(home ? home : ".") + "/.ros";
+    return directory + "/ros_gremsy_telemetry";
+}
+
+// Scheduling of a thread from its configured priority and CPU list, an invalid list keeps the affinity
+static ThreadScheduling threadScheduling(int priority, const std::string& cpus, const char* name)
+{
+    ThreadScheduling scheduling;
+    scheduling.priority = priority;
+    std::string error;
+    if(!parseCpuList(cpus, scheduling.cpus, error))
+    {
+        ROS_ERROR("Ignoring the CPUs of the %s, %s", name, error.c_str());
+    }
+    return scheduling;
+}
+
+// Reports the last feedback of a goal of the point action as its result
+static ros_gremsy::PointGimbalResult pointResult(const ros_gremsy::PointGimbalFeedback& feedback)
+{
+    ros_gremsy::PointGimbalResult result;
+    result.angles = feedback.angles;
+    result.error = feedback.error;
+    return result;
+}
+
+GimbalNode::GimbalNode(ros::NodeHandle nh, ros::NodeHandle pnh) :
+    GimbalNode(nh, pnh, nullptr)
+{
+}
+
+GimbalNode::GimbalNode(ros::NodeHandle nh, ros::NodeHandle pnh, std::shared_ptr<GimbalExecutor> executor) :
+    owns_executor_(!executor),
+    executor_(executor ? executor : std::make_shared<GimbalExecutor>()),
+    reconfigure_server_(withCallbackQueue(pnh, &executor_->reconfigure_queue)),
+    diagnostics_(nh, pnh)
 {
     // Initialize dynamic-reconfigure
-    dynamic_reconfigure::Server<ros_gremsy::ROSGremsyConfig> server(pnh);
     dynamic_reconfigure::Server<ros_gremsy::ROSGremsyConfig>::CallbackType f;
     f = boost::bind(&GimbalNode::reconfigureCallback, this, _1, _2);
-    server.setCallback(f);
+    reconfigure_server_.setCallback(f);
+    ConfigConstPtr config = currentConfig();
+
+    // Locked before the pools and queues are allocated, so they never page fault either
+    if(config->lock_memory)
+    {
+        std::string error;
+        if(lockProcessMemory(error))
+        {
+            ROS_INFO("Locked the memory of the process");
+        }
+        else
+        {
+            ROS_WARN("Can not keep the process in memory, %s", error.c_str());
+        }
+    }
+    serial_scheduling_ = threadScheduling(config->serial_thread_priority, config->serial_thread_cpus, "serial threads");
+    command_scheduling_ = threadScheduling(config->command_thread_priority, config->command_thread_cpus, "command writer");
+    telemetry_scheduling_ = threadScheduling(config->telemetry_thread_priority, config->telemetry_thread_cpus,
+        "sample watcher");
 
-    // Advertive Publishers
-    imu_pub = pnh.advertise<sensor_msgs::Imu>("imu/data", 10);
-    encoder_pub = pnh.advertise<geometry_msgs::Vector3Stamped>("encoder", 1000);
-    mount_orientation_incl_global_yaw = pnh.advertise<geometry_msgs::Quaternion>("mount_orientation_global_yaw", 10);
-    mount_orientation_incl_local_yaw = pnh.advertise<geometry_msgs::Quaternion>("mount_orientation_local_yaw", 10);
+    // Advertive Publishers, streams without subscribers are neither converted nor requested at the full rate
+    ros::SubscriberStatusCallback subscribers_changed = boost::bind(&GimbalNode::subscribersChangedCallback, this, _1);
+    imu_pub = pnh.advertise<sensor_msgs::Imu>("imu/data", 10, subscribers_changed, subscribers_changed);
+    imu_batch_pub = pnh.advertise<ros_gremsy::ImuBatch>("imu/batch", 10, subscribers_changed, subscribers_changed);
+    encoder_pub = pnh.advertise<geometry_msgs::Vector3Stamped>("encoder", 1000, subscribers_changed, subscribers_changed);
+    encoder_velocity_pub = pnh.advertise<geometry_msgs::Vector3Stamped>("encoder_velocity", 1000,
+        subscribers_changed, subscribers_changed);
+    mount_orientation_incl_global_yaw = pnh.advertise<geometry_msgs::Quaternion>("mount_orientation_global_yaw", 10,
+        subscribers_changed, subscribers_changed);
+    mount_orientation_incl_local_yaw = pnh.advertise<geometry_msgs::Quaternion>("mount_orientation_local_yaw", 10,
+        subscribers_changed, subscribers_changed);
 
 
+    // Commands and telemetry are served by separate spinners, so neither of them waits for the other
+    ros::NodeHandle command_nh = withCallbackQueue(pnh, &executor_->command_queue);
+    ros::NodeHandle telemetry_nh = withCallbackQueue(nh, &executor_->telemetry_queue);
+
     // Register Subscribers
-    gimbal_goal_sub = pnh.subscribe("goals", 1, &GimbalNode::setGoalsCallback, this);
+    gimbal_goal_sub = command_nh.subscribe("goals", 1, &GimbalNode::setGoalsCallback, this,
+        ros::TransportHints().tcpNoDelay());
+    gimbal_rate_goal_sub = command_nh.subscribe("goals_rate", 1, &GimbalNode::setRateGoalsCallback, this,
+        ros::TransportHints().tcpNoDelay());
+    gimbal_trajectory_sub = command_nh.subscribe("trajectory", 1, &GimbalNode::trajectoryCallback, this,
+        ros::TransportHints().tcpNoDelay());
+
+    gimbal_state_pub = pnh.advertise<ros_gremsy::GimbalState>("state", 10, subscribers_changed, subscribers_changed);
+    status_pub = pnh.advertise<ros_gremsy::GimbalStatus>("status", 1, true);
+    stats_pub = pnh.advertise<ros_gremsy::PipelineStats>("stats", 10);
+    tf_pub = nh.advertise<tf2_msgs::TFMessage>("/tf", 100);
+
+    // The SDK only talks to serial devices, with UDP, reconnects or direct telemetry it opens a pseudo terminal
+    // bridged to the link. The SDK keeps the pseudo terminal while the bridge reopens a failed serial device.
+    std::string device = config->device;
+    bool bridged = config->transport == UDP_TRANSPORT || config->reconnect || config->direct_telemetry;
+    link_bridged_ = bridged;
+
+    // Started before the link, so the first frames of the gimbal are recorded as well
+    if(config->record)
+    {
+        std::string prefix = config->record_path.empty() ? defaultRecordPrefix() : config->record_path;
+        std::string error;
+        if(recorder_.start(prefix, (size_t) config->record_file_size << 20, config->record_max_files, error))
+        {
+            ROS_INFO("Recording the telemetry to %s_*", prefix.c_str());
+            // A bridged link records every received frame, the SDK only provides the decoded telemetry
+            record_sdk_messages_ = !bridged;
+        }
+        else
+        {
+            ROS_ERROR("Can not record the telemetry, %s", error.c_str());
+        }
+    }
+
+    if(bridged)
+    {
+        // Framed by the bridge for the link statistics, the recording and the direct telemetry
+        link_bridge_.setPacketHandler(boost::bind(&GimbalNode::handleTelemetryPacket, this, _1));
+        link_bridge_.setReconnectInterval(config->reconnect_interval);
+        link_bridge_.setThreadScheduling(serial_scheduling_);
+
+        std::string error;
+        bool started = config->transport == UDP_TRANSPORT ?
+            link_bridge_.startUdp(config->udp_local_port, config->udp_remote_host, config->udp_remote_port, error) :
+            link_bridge_.startSerial(config->device, config->baudrate, config->ftdi_latency_timer, error);
+        if(!started)
+        {
+            ROS_ERROR("Can not start the link to the gimbal, %s", error.c_str());
+        }
+        device = link_bridge_.device();
+    }
+
+    // The SDK only knows the baudrates up to 921600, higher ones are set by the low latency configuration or the bridge
+    int sdk_baudrate = config->baudrate <= 921600 ? config->baudrate : 115200;
 
     // Define SDK objects
-    serial_port_ = new Serial_Port(config_.device.c_str(), config_.baudrate);
+    serial_port_ = new Serial_Port(device.c_str(), sdk_baudrate);
     gimbal_interface_ = new Gimbal_Interface(serial_port_);
 
-    // Start ther serial interface and the gimbal SDK
+    // Start ther serial interface and the gimbal SDK. Starting the SDK blocks until the
+    // gimbal answers, so it runs in its own thread and the init timer below polls the result.
     serial_port_->start();
-    gimbal_interface_->start();
+    // A bridged link has already been configured by the bridge
+    if(!bridged && config->low_latency)
+    {
+        // Applied after the SDK opened the port, otherwise its own settings would replace them
+        std::string error;
+        if(!configureLowLatencySerial(device, config->baudrate, config->ftdi_latency_timer, error))
+        {
+            ROS_WARN("Can not configure %s for low latency, %s", device.c_str(), error.c_str());
+        }
+    }
+    else if(!bridged && sdk_baudrate != config->baudrate)
+    {
+        ROS_WARN("Baudrates above 921600 need low_latency, falling back to %d", sdk_baudrate);
+    }
+    sdk_started_ = std::make_shared<std::atomic<bool>>(false);
+    // The read and write threads of the SDK inherit the scheduling of the thread starting it
+    std::thread([gimbal_interface = gimbal_interface_, started = sdk_started_, scheduling = serial_scheduling_]()
+    {
+        applyThreadScheduling(scheduling, "SDK threads");
+        gimbal_interface->start();
+        *started = true;
+    }).detach();
 
     ///////////////////
     // Config Gimbal //
     ///////////////////
 
-    // Check if gimbal is on
-    if(gimbal_interface_->get_gimbal_status().mode == GIMBAL_STATE_OFF)
+    // The gimbal is configured step by step while the telemetry is already published
+    init_start_ = ros::WallTime::now().toSec();
+    setInitState(ros_gremsy::GimbalStatus::CONNECTING, "Waiting for the gimbal");
+    init_timer_ = command_nh.createTimer(
+        ros::Duration(0.1),
+        &GimbalNode::initTimerCallback, this);
+
+    // Only runs while a trajectory is active
+    trajectory_timer_ = command_nh.createTimer(
+        ros::Duration(1/config->trajectory_rate),
+        &GimbalNode::trajectoryTimerCallback, this, false, false);
+
+    // Started with every goal of the point action which has a timeout
+    point_timer_ = command_nh.createTimer(
+        ros::Duration(1.0),
+        &GimbalNode::pointTimeoutCallback, this, true, false);
+
+    state_timer_ = telemetry_nh.createTimer(
+        ros::Duration(1/config->state_poll_rate),
+        &GimbalNode::gimbalStateTimerCallback, this);
+
+    // No subscriber can be connected yet
+    updateStreamDemand();
+
+    // Configure the time synchronization
+    imu_clock_.setWindowSize(config->time_sync_window);
+    mount_orientation_clock_.setWindowSize(config->time_sync_window);
+
+    // Initialize diagnostics
+    // The gimbals of a MultiGimbalNode or a nodelet manager report under the name of the process,
+    // so their tasks are told apart by the namespace of each gimbal
+    std::string task_prefix = pnh.getNamespace() == ros::this_node::getName() ? "" : pnh.getNamespace() + " ";
+    diagnostics_.setHardwareID(config->device);
+    diagnostics_.add(task_prefix + "Telemetry", this, &GimbalNode::telemetryDiagnostics);
+    diagnostics_.add(task_prefix + "Link", this, &GimbalNode::linkDiagnostics);
+    diagnostics_.add(task_prefix + "Commands", this, &GimbalNode::commandDiagnostics);
+    diagnostics_.add(task_prefix + "Latency", this, &GimbalNode::latencyDiagnostics);
+
+    diagnostics_timer_ = telemetry_nh.createTimer(
+        ros::Duration(1.0),
+        &GimbalNode::diagnosticsTimerCallback, this);
+
+    stats_timer_ = telemetry_nh.createTimer(
+        ros::Duration(config->stats_period),
+        &GimbalNode::statsTimerCallback, this);
+
+    link_watchdog_timer_ = telemetry_nh.createTimer(
+        ros::Duration(0.1),
+        &GimbalNode::linkWatchdogCallback, this);
+
+    // Preallocate the published messages, they are recycled once all subscribers released them
+    imu_pool_.resize(config->message_pool_size);
+    imu_batch_pool_.resize(config->message_pool_size);
+    encoder_pool_.resize(config->message_pool_size);
+    encoder_velocity_pool_.resize(config->message_pool_size);
+    mount_orientation_global_pool_.resize(config->message_pool_size);
+    mount_orientation_local_pool_.resize(config->message_pool_size);
+    gimbal_state_pool_.resize(config->message_pool_size);
+    tf_pool_.resize(config->message_pool_size);
+
+    // Size the sample queues to hold the messages arriving between two timer ticks
+    imu_queue_.resize(config->queue_size);
+    mount_status_queue_.resize(config->queue_size);
+    mount_orientation_queue_.resize(config->queue_size);
+
+    // Collect every new message, in event driven mode it is published directly
+    // and the timer above is only used as fallback. With direct telemetry the
+    // bridge hands the messages over instead of the SDK.
+    if(config->direct_telemetry)
+    {
+        direct_telemetry_ready_ = true;
+    }
+    else
     {
-        // Turn on gimbal
-        ROS_INFO("TURN_ON!\n");
-        gimbal_interface_->set_gimbal_motor_mode(TURN_ON);
+        sample_watcher_running_ = true;
+        sample_watcher_ = std::thread(&GimbalNode::sampleWatcherLoop, this);
     }
 
-    // Wait until the gimbal is on
-    while (gimbal_interface_->get_gimbal_status().mode < GIMBAL_STATE_ON)
+    // Goals are sent to the gimbal by their own thread, so a slow serial write never blocks a callback
+    command_writer_running_ = true;
+    command_writer_ = std::thread(&GimbalNode::commandWriterLoop, this);
+
+    // Goals of the point action are served with the other commands
+    point_server_ = std::make_unique<PointGimbalServer>(command_nh, "point",
+        boost::bind(&GimbalNode::pointGoalCallback, this, _1),
+        boost::bind(&GimbalNode::pointCancelCallback, this, _1), false);
+    point_server_->start();
+
+    // Start serving the callback queues, a shared executor is started by its owner
+    if(owns_executor_)
     {
-        ros::Duration(0.2).sleep();
+        executor_->start(config->command_threads, config->telemetry_threads);
     }
+}
 
-    // Set gimbal control modes
+GimbalNode::~GimbalNode()
+{
+    // No callback may run while the node is torn down, the owner of a shared executor stops it before
+    if(owns_executor_)
+    {
+        executor_->stop();
+    }
+
+    // The bridge thread dispatches into the streams, the pools and the publishers, so it is stopped
+    // before anything else and even if the SDK is left running below
+    link_bridge_.stop();
+
+    init_timer_.stop();
+    sample_watcher_running_ = false;
+    if(sample_watcher_.joinable())
+    {
+        sample_watcher_.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(command_mutex_);
+        command_writer_running_ = false;
+    }
+    command_cv_.notify_all();
+    if(command_writer_.joinable())
+    {
+        command_writer_.join();
+    }
+    // The watcher was the last thread recording
+    recorder_.stop();
+
+    // The SDK can not be stopped while it is still waiting for the gimbal,
+    // so it is left to the detached start thread in that case
+    if(!*sdk_started_)
+    {
+        ROS_WARN("The gimbal never answered, leaving the SDK running");
+        return;
+    }
+
+    // Stop the SDK threads before the serial port is closed
+    gimbal_interface_->stop();
+    serial_port_->stop();
+    delete gimbal_interface_;
+    delete serial_port_;
+}
+
+void GimbalNode::initTimerCallback(const ros::TimerEvent& event)
+{
+    ConfigConstPtr config = currentConfig();
+    uint8_t state = init_state_;
+
+    if(config->init_timeout > 0.0 && ros::WallTime::now().toSec() - init_start_ > config->init_timeout)
+    {
+        init_timer_.stop();
+        ROS_ERROR("Gimbal startup timed out after %.1f s, telemetry is still published if available", config->init_timeout);
+        setInitState(ros_gremsy::GimbalStatus::FAILED, "Timed out while " + initStateToString(state));
+        return;
+    }
+
+    switch(state)
+    {
+        case ros_gremsy::GimbalStatus::CONNECTING:
+            if(!*sdk_started_)
+            {
+                return;
+            }
+            // After a lost link the status of the SDK is stale until the gimbal sent a new heartbeat
+            if(gimbal_interface_->get_gimbal_time_stamps().heartbeat <= resume_stamp_)
+            {
+                return;
+            }
+            // Check if gimbal is on, a gimbal which kept running over a lost link is not turned on again
+            if(gimbal_interface_->get_gimbal_status().mode == GIMBAL_STATE_OFF)
+            {
+                // Turn on gimbal
+                ROS_INFO("TURN_ON!\n");
+                gimbal_interface_->set_gimbal_motor_mode(TURN_ON);
+            }
+            setInitState(ros_gremsy::GimbalStatus::TURNING_ON_MOTORS, "Waiting for the motors");
+            break;
+
+        case ros_gremsy::GimbalStatus::TURNING_ON_MOTORS:
+            // Wait until the gimbal is on
+            if(gimbal_interface_->get_gimbal_status().mode < GIMBAL_STATE_ON)
+            {
+                return;
+            }
+            setInitState(ros_gremsy::GimbalStatus::CONFIGURING_AXES, "Setting the gimbal and axis modes");
+            break;
 
-    gimbal_interface_->set_gimbal_mode(convertIntGimbalMode(config_.gimbal_mode));
+        case ros_gremsy::GimbalStatus::CONFIGURING_AXES:
+            configureGimbal();
+            requestStreamRates();
+            init_timer_.stop();
+            setInitState(ros_gremsy::GimbalStatus::STREAMING, "Gimbal is ready");
+            break;
 
-    // Set modes for each axis
+        default:
+            init_timer_.stop();
+            break;
+    }
+}
+
+void GimbalNode::configureGimbal()
+{
+    ConfigConstPtr config = currentConfig();
+    // Set gimbal control modes
+    gimbal_interface_->set_gimbal_mode(convertIntGimbalMode(config->gimbal_mode));
+
+    configureAxes(false);
+}
 
+void GimbalNode::configureAxes(bool rate_control)
+{
+    ConfigConstPtr config = currentConfig();
+    // Set modes for each axis, rate control overrides the configured input modes
     control_gimbal_axis_mode_t tilt_axis_mode, roll_axis_mode, pan_axis_mode;
 
-    tilt_axis_mode.input_mode = convertIntToAxisInputMode(config_.tilt_axis_input_mode);
-    tilt_axis_mode.stabilize = config_.tilt_axis_stabilize;
+    tilt_axis_mode.input_mode = rate_control ? CTRL_ANGULAR_RATE : convertIntToAxisInputMode(config->tilt_axis_input_mode);
+    tilt_axis_mode.stabilize = config->tilt_axis_stabilize;
 
-    roll_axis_mode.input_mode = convertIntToAxisInputMode(config_.roll_axis_input_mode);
-    roll_axis_mode.stabilize = config_.roll_axis_stabilize;
+    roll_axis_mode.input_mode = rate_control ? CTRL_ANGULAR_RATE : convertIntToAxisInputMode(config->roll_axis_input_mode);
+    roll_axis_mode.stabilize = config->roll_axis_stabilize;
 
-    pan_axis_mode.input_mode = convertIntToAxisInputMode(config_.pan_axis_input_mode);
-    pan_axis_mode.stabilize = config_.pan_axis_stabilize;
+    pan_axis_mode.input_mode = rate_control ? CTRL_ANGULAR_RATE : convertIntToAxisInputMode(config->pan_axis_input_mode);
+    pan_axis_mode.stabilize = config->pan_axis_stabilize;
 
     gimbal_interface_->set_gimbal_axes_mode(tilt_axis_mode, roll_axis_mode, pan_axis_mode);
+}
 
-    ros::Timer timer = nh.createTimer(
-        ros::Duration(1/config_.state_poll_rate),
-        &GimbalNode::gimbalStateTimerCallback, this);
+void GimbalNode::requestStreamRates()
+{
+    ConfigConstPtr config = currentConfig();
+    // Streams nobody consumes are only requested at the idle rate
+    requestMessageInterval(MAVLINK_MSG_ID_RAW_IMU,
+        imu_stream_.demanded ? config->raw_imu_rate : config->idle_stream_rate);
+    requestMessageInterval(MAVLINK_MSG_ID_MOUNT_STATUS,
+        encoder_stream_.demanded ? config->mount_status_rate : config->idle_stream_rate);
+    requestMessageInterval(MAVLINK_MSG_ID_MOUNT_ORIENTATION,
+        mount_orientation_stream_.demanded ? config->mount_orientation_rate : config->idle_stream_rate);
+}
+
+void GimbalNode::subscribersChangedCallback(const ros::SingleSubscriberPublisher& publisher)
+{
+    applyStreamDemand();
+}
 
-    ros::spin();
+void GimbalNode::applyStreamDemand()
+{
+    // The rates of changed streams are sent once the gimbal is streaming
+    if(updateStreamDemand() && init_state_ == ros_gremsy::GimbalStatus::STREAMING)
+    {
+        requestStreamRates();
+    }
+}
+
+bool GimbalNode::updateStreamDemand()
+{
+    ConfigConstPtr config = currentConfig();
+    bool state = config->publish_state && gimbal_state_pub.getNumSubscribers() > 0;
+    bool legacy = config->publish_legacy_topics;
+
+    bool imu = !config->lazy_publishing || state ||
+        (legacy && imu_pub.getNumSubscribers() > 0) ||
+        (config->imu_batch && imu_batch_pub.getNumSubscribers() > 0);
+    bool encoder = !config->lazy_publishing || state ||
+        (legacy && encoder_pub.getNumSubscribers() > 0) ||
+        encoder_velocity_pub.getNumSubscribers() > 0 || point_active_;
+    // The subscribers of the transforms are unknown, so broadcasting them always needs the stream
+    bool mount_orientation = !config->lazy_publishing || state || config->publish_tf ||
+        (legacy && (mount_orientation_incl_global_yaw.getNumSubscribers() > 0 ||
+            mount_orientation_incl_local_yaw.getNumSubscribers() > 0));
+
+    bool changed = imu_stream_.demanded.exchange(imu) != imu;
+    changed |= encoder_stream_.demanded.exchange(encoder) != encoder;
+    changed |= mount_orientation_stream_.demanded.exchange(mount_orientation) != mount_orientation;
+    return changed;
+}
+
+void GimbalNode::requestMessageInterval(uint32_t message_id, double rate)
+{
+    ConfigConstPtr config = currentConfig();
+    // An interval of 0 restores the default rate of the firmware
+    float interval_us = rate > 0.0 ? 1e6 / rate : 0.0;
+
+    mavlink_message_t message;
+    mavlink_msg_command_long_pack(
+        COMPANION_SYSTEM_ID, COMPANION_COMPONENT_ID, &message,
+        config->gimbal_system_id, config->gimbal_component_id,
+        MAV_CMD_SET_MESSAGE_INTERVAL, 0,
+        message_id, interval_us, 0, 0, 0, 0, 0);
+    gimbal_interface_->write_message(message);
+}
+
+void GimbalNode::setInitState(uint8_t state, const std::string& message)
+{
+    init_state_ = state;
+
+    ros_gremsy::GimbalStatusPtr status = boost::make_shared<ros_gremsy::GimbalStatus>();
+    status->header.stamp = ros::Time::now();
+    status->state = state;
+    status->message = message;
+    status_pub.publish(status);
+
+    ROS_INFO("Gimbal %s: %s", initStateToString(state).c_str(), message.c_str());
+}
+
+std::string GimbalNode::initStateToString(uint8_t state)
+{
+    switch(state) {
+        case ros_gremsy::GimbalStatus::CONNECTING : return "connecting";
+        case ros_gremsy::GimbalStatus::TURNING_ON_MOTORS : return "turning on motors";
+        case ros_gremsy::GimbalStatus::CONFIGURING_AXES : return "configuring axes";
+        case ros_gremsy::GimbalStatus::STREAMING : return "streaming";
+        case ros_gremsy::GimbalStatus::FAILED : return "failed";
+        case ros_gremsy::GimbalStatus::RECONNECTING : return "reconnecting";
+        default: return "unknown";
+    }
 }
 
 void GimbalNode::gimbalStateTimerCallback(const ros::TimerEvent& event)
 {
+    ConfigConstPtr config = currentConfig();
+    if(!config->event_driven)
+    {
+        drainSampleQueues();
+    }
+    // Only fall back to the cached samples if the event driven path did not publish since the last tick
+    else if(!event_published_.exchange(false))
+    {
+        publishLatestSamples();
+    }
+}
+
+void GimbalNode::publishGimbalState()
+{
+    ConfigConstPtr config = currentConfig();
+    if(!config->publish_state)
+    {
+        return;
+    }
+
+    ros_gremsy::GimbalStatePtr state;
+    {
+        std::lock_guard<std::mutex> lock(gimbal_state_mutex_);
+        // The mount orientation only updates the cache, the state follows the encoder and IMU stream
+        if(!gimbal_state_imu_ || !gimbal_state_encoder_)
+        {
+            return;
+        }
+        state = gimbal_state_pool_.acquire();
+        *state = gimbal_state_;
+        gimbal_state_imu_ = false;
+        gimbal_state_encoder_ = false;
+    }
+
+    state->header.stamp = ros::Time::now();
+    state->init_state = init_state_;
+    state->gimbal_mode = gimbal_interface_->get_gimbal_status().mode;
+    gimbal_state_pub.publish(state);
+}
+
+void GimbalNode::sampleWatcherLoop()
+{
+    ConfigConstPtr config = currentConfig();
+    applyThreadScheduling(telemetry_scheduling_, "sample watcher thread");
+
+    Time_Stamps last_stamps = gimbal_interface_->get_gimbal_time_stamps();
+    double check_rate = config->sample_check_rate;
+    ros::WallRate rate(check_rate);
+
+    while(sample_watcher_running_ && ros::ok())
+    {
+        // Reconfigured values are picked up with every iteration
+        config = currentConfig();
+
+        // The SDK updates the receive time stamp of a stream for every decoded message
+        Time_Stamps stamps = gimbal_interface_->get_gimbal_time_stamps();
+        bool imu_changed = stamps.raw_imu != last_stamps.raw_imu;
+        bool mount_status_changed = stamps.mount_status != last_stamps.mount_status;
+        bool mount_orientation_changed = stamps.mount_orientation != last_stamps.mount_orientation;
+
+        if(imu_changed || mount_status_changed || mount_orientation_changed)
+        {
+            GimbalSnapshot& snapshot = writer_snapshot_;
+            if(imu_changed)
+            {
+                snapshot.raw_imu = gimbal_interface_->get_gimbal_raw_imu();
+            }
+            if(mount_status_changed)
+            {
+                snapshot.mount_status = gimbal_interface_->get_gimbal_mount_status();
+            }
+            if(mount_orientation_changed)
+            {
+                snapshot.mount_orientation = gimbal_interface_->get_gimbal_mount_orientation();
+            }
+            int64_t pickup_time = monotonicNanoseconds();
+            int64_t wall_time = wallClockMicroseconds();
+
+            // A message is only taken with its time stamp if both did not change while it was read,
+            // otherwise it is read again in the next iteration
+            Time_Stamps check = gimbal_interface_->get_gimbal_time_stamps();
+            imu_changed &= check.raw_imu == stamps.raw_imu;
+            mount_status_changed &= check.mount_status == stamps.mount_status;
+            mount_orientation_changed &= check.mount_orientation == stamps.mount_orientation;
+            stamps.raw_imu = imu_changed ? stamps.raw_imu : last_stamps.raw_imu;
+            stamps.mount_status = mount_status_changed ? stamps.mount_status : last_stamps.mount_status;
+            stamps.mount_orientation = mount_orientation_changed ? stamps.mount_orientation : last_stamps.mount_orientation;
+
+            snapshot.stamps.raw_imu = stamps.raw_imu;
+            snapshot.stamps.mount_status = stamps.mount_status;
+            snapshot.stamps.mount_orientation = stamps.mount_orientation;
+            snapshot_.store(snapshot);
+
+            // The SDK only keeps the decoded messages, so they are encoded again for the log
+            if(record_sdk_messages_)
+            {
+                mavlink_message_t message;
+                if(imu_changed)
+                {
+                    mavlink_msg_raw_imu_encode_chan(config->gimbal_system_id, config->gimbal_component_id,
+                        RECORDER_MAVLINK_CHANNEL, &message, &snapshot.raw_imu);
+                    recordMessage(stamps.raw_imu, message);
+                }
+                if(mount_status_changed)
+                {
+                    mavlink_msg_mount_status_encode_chan(config->gimbal_system_id, config->gimbal_component_id,
+                        RECORDER_MAVLINK_CHANNEL, &message, &snapshot.mount_status);
+                    recordMessage(stamps.mount_status, message);
+                }
+                if(mount_orientation_changed)
+                {
+                    mavlink_msg_mount_orientation_encode_chan(config->gimbal_system_id, config->gimbal_component_id,
+                        RECORDER_MAVLINK_CHANNEL, &message, &snapshot.mount_orientation);
+                    recordMessage(stamps.mount_orientation, message);
+                }
+            }
+
+            if(imu_changed)
+            {
+                trackArrival(imu_stream_, stamps.raw_imu, config->raw_imu_rate);
+                trackMissed(imu_stream_, snapshot.raw_imu.time_usec, config->raw_imu_rate);
+                imu_stream_.pickup_latency.record((wall_time - (int64_t) stamps.raw_imu) * 1000);
+                dispatchImu(RawImuSample{stamps.raw_imu, snapshot.raw_imu, pickup_time});
+            }
+            if(mount_status_changed)
+            {
+                trackArrival(encoder_stream_, stamps.mount_status, config->mount_status_rate);
+                encoder_stream_.pickup_latency.record((wall_time - (int64_t) stamps.mount_status) * 1000);
+                dispatchEncoder(MountStatusSample{stamps.mount_status, snapshot.mount_status, pickup_time});
+            }
+            if(mount_orientation_changed)
+            {
+                trackArrival(mount_orientation_stream_, stamps.mount_orientation, config->mount_orientation_rate);
+                trackMissed(mount_orientation_stream_, (uint64_t) snapshot.mount_orientation.time_boot_ms * 1000,
+                    config->mount_orientation_rate);
+                mount_orientation_stream_.pickup_latency.record((wall_time - (int64_t) stamps.mount_orientation) * 1000);
+                dispatchMountOrientation(MountOrientationSample{stamps.mount_orientation, snapshot.mount_orientation, pickup_time});
+            }
+        }
+
+        last_stamps = stamps;
+
+        // Follow a reconfigured check rate
+        if(config->sample_check_rate != check_rate)
+        {
+            check_rate = config->sample_check_rate;
+            rate = ros::WallRate(check_rate);
+        }
+        rate.sleep();
+    }
+}
+
+void GimbalNode::trackArrival(StreamState& stream, uint64_t stamp, double requested_rate)
+{
+    ConfigConstPtr config = currentConfig();
+    // Streams without consumers are only requested at the idle rate, a rate of 0 leaves it to the gimbal
+    double rate = stream.demanded ? requested_rate : config->idle_stream_rate;
+    uint64_t previous = stream.last_arrival.exchange(stamp);
+    if(previous > 0 && rate > 0.0 && stamp > previous && (stamp - previous) * 1e-6 > STREAM_GAP_PERIODS / rate)
+    {
+        stream.gaps++;
+    }
+    stream.arrivals++;
+}
+
+void GimbalNode::trackMissed(StreamState& stream, uint64_t device_stamp, double requested_rate)
+{
+    ConfigConstPtr config = currentConfig();
+    double rate = stream.demanded ? requested_rate : config->idle_stream_rate;
+    uint64_t previous = stream.last_device_stamp.exchange(device_stamp);
+    // Without a requested rate the period is unknown, a clock running backwards is a restarted gimbal
+    if(previous == 0 || rate <= 0.0 || device_stamp <= previous)
+    {
+        return;
+    }
+    int64_t periods = std::llround((device_stamp - previous) * 1e-6 * rate);
+    if(periods > 1)
+    {
+        stream.missed += periods - 1;
+    }
+}
+
+void GimbalNode::linkWatchdogCallback(const ros::TimerEvent& event)
+{
+    ConfigConstPtr config = currentConfig();
+    // The first startup has a timeout of its own, the watchdog only takes over once the gimbal streamed
+    if(init_state_ == ros_gremsy::GimbalStatus::STREAMING)
+    {
+        link_watched_ = true;
+    }
+    if(config->link_timeout <= 0.0 || !link_watched_)
+    {
+        return;
+    }
+
+    // Any message counts, the heartbeats keep a link alive whose streams are all idle
+    uint64_t last_message = std::max({
+        gimbal_interface_->get_gimbal_time_stamps().heartbeat,
+        imu_stream_.last_arrival.load(),
+        encoder_stream_.last_arrival.load(),
+        mount_orientation_stream_.last_arrival.load()});
+    uint64_t now = wallClockMicroseconds();
+    uint64_t timeout = config->link_timeout * 1e6;
+    // A failed serial device is noticed by the bridge right away
+    bool device_failed = link_bridged_ && !link_bridge_.connected();
+    bool silent = device_failed || now > last_message + timeout;
+    bool reconnectable = link_bridged_ && config->transport == SERIAL_TRANSPORT;
+
+    if(silent && !link_lost_)
+    {
+        link_lost_ = true;
+        link_lost_stamp_ = now;
+        link_losses_++;
+        ROS_ERROR("Lost the link to the gimbal, no message for %.1f s", (now - last_message) * 1e-6);
+        setInitState(ros_gremsy::GimbalStatus::RECONNECTING,
+            reconnectable ? "Link lost, reopening the device" : "Link lost, waiting for the gimbal");
+        // A device which is open but silent, e.g. a hanging adapter, is reopened as well
+        if(reconnectable && !device_failed)
+        {
+            link_bridge_.requestReconnect();
+        }
+        last_reconnect_request_ = now;
+    }
+    else if(silent && reconnectable && link_bridge_.connected() && now > last_reconnect_request_ + timeout)
+    {
+        // Reopened, but the gimbal is still silent
+        link_bridge_.requestReconnect();
+        last_reconnect_request_ = now;
+    }
+    else if(!silent && link_lost_)
+    {
+        link_lost_ = false;
+        link_recoveries_++;
+        ROS_INFO("Link to the gimbal is back after %.2f s", (now - link_lost_stamp_) * 1e-6);
+
+        // The gimbal may have been power cycled, so the startup runs again. It waits for a new heartbeat,
+        // only turns on the motors if they are off and sends the modes and stream rates again.
+        resume_stamp_ = now;
+        init_start_ = ros::WallTime::now().toSec();
+        setInitState(ros_gremsy::GimbalStatus::CONNECTING, "Link recovered, waiting for a heartbeat");
+        init_timer_.start();
+    }
+}
+
+void GimbalNode::linkDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    if(link_lost_)
+    {
+        status.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Link lost");
+    }
+    else if(link_bridged_ && !link_bridge_.connected())
+    {
+        status.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Device closed");
+    }
+    else
+    {
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Connected");
+    }
+
+    // Rates over the time since the last report
+    ros::WallTime now = ros::WallTime::now();
+    double period = last_link_diagnostics_.toSec() > 0.0 ? (now - last_link_diagnostics_).toSec() : 0.0;
+    last_link_diagnostics_ = now;
+    auto rate = [period](uint64_t count, uint64_t& last_count)
+    {
+        double result = period > 0.0 ? (count - last_count) / period : 0.0;
+        last_count = count;
+        return result;
+    };
+
+    status.addf("IMU rate [Hz]", "%.1f", rate(imu_stream_.arrivals, last_imu_arrivals_));
+    status.add("IMU gaps", imu_stream_.gaps.load());
+    status.addf("Encoder rate [Hz]", "%.1f", rate(encoder_stream_.arrivals, last_encoder_arrivals_));
+    status.add("Encoder gaps", encoder_stream_.gaps.load());
+    status.addf("Mount orientation rate [Hz]", "%.1f",
+        rate(mount_orientation_stream_.arrivals, last_mount_orientation_arrivals_));
+    status.add("Mount orientation gaps", mount_orientation_stream_.gaps.load());
+    status.add("Link losses", link_losses_.load());
+    status.add("Link recoveries", link_recoveries_.load());
+    if(link_bridged_)
+    {
+        status.addf("Packet rate [Hz]", "%.1f", rate(link_bridge_.packets(), last_link_packets_));
+        status.add("Packets lost", link_packets_lost_.load());
+        status.add("Packets with bad checksum", link_bridge_.bad_checksums());
+        status.add("Packets with unknown message id", link_bridge_.unknown_messages());
+        status.add("Packets handled directly", link_bridge_.consumed());
+        status.add("Packets not forwarded to the SDK", link_bridge_.forward_failures());
+        status.add("Link reads", link_bridge_.received());
+        status.add("Link writes", link_bridge_.sent());
+        status.add("Device reopened", link_bridge_.reconnects());
+    }
+}
+
+void GimbalNode::dispatchImu(const RawImuSample& sample)
+{
+    ConfigConstPtr config = currentConfig();
+    if(config->event_driven)
+    {
+        publishImu(sample);
+        event_published_ = true;
+    }
+    else if(!imu_queue_.push(sample))
+    {
+        imu_stream_.overflows++;
+    }
+}
+
+void GimbalNode::dispatchEncoder(const MountStatusSample& sample)
+{
+    ConfigConstPtr config = currentConfig();
+    if(config->event_driven)
+    {
+        publishEncoder(sample);
+        event_published_ = true;
+    }
+    else if(!mount_status_queue_.push(sample))
+    {
+        encoder_stream_.overflows++;
+    }
+}
+
+void GimbalNode::dispatchMountOrientation(const MountOrientationSample& sample)
+{
+    ConfigConstPtr config = currentConfig();
+    if(config->event_driven)
+    {
+        publishMountOrientation(sample);
+        event_published_ = true;
+    }
+    else if(!mount_orientation_queue_.push(sample))
+    {
+        mount_orientation_stream_.overflows++;
+    }
+}
+
+bool GimbalNode::handleTelemetryPacket(const MavlinkPacket& packet)
+{
+    ConfigConstPtr config = currentConfig();
+    // Packets from other components are left to the SDK
+    if(packet.system_id != config->gimbal_system_id || packet.component_id != config->gimbal_component_id)
+    {
+        return false;
+    }
+
+    // The receive time stamps identify the samples, so they have to be unique even within a single read
+    uint64_t stamp = std::max<uint64_t>(wallClockMicroseconds(), last_direct_stamp_ + 1);
+
+    // Gaps in the sequence numbers are packets lost on the link
+    if(link_sequence_valid_)
+    {
+        link_packets_lost_ += (uint8_t) (packet.sequence - link_sequence_ - 1);
+    }
+    link_sequence_ = packet.sequence;
+    link_sequence_valid_ = true;
+
+    // Every packet is recorded as received, including the ones which are left to the SDK
+    if(recorder_.active())
+    {
+        recorder_.record(stamp, ros::Time::now().toNSec(), packet.data, packet.length);
+    }
+
+    // Everything arriving before the node is set up is left to the SDK, as well as everything without direct telemetry
+    if(!direct_telemetry_ready_)
+    {
+        return false;
+    }
+
+    // The pickup stage covers framing and decoding, from the read which completed the packet until the sample is ready
+    int64_t pickup_time;
+    switch(packet.message_id)
+    {
+        case MAVLINK_MSG_ID_RAW_IMU:
+            packet.decode(writer_snapshot_.raw_imu);
+            pickup_time = monotonicNanoseconds();
+            writer_snapshot_.stamps.raw_imu = stamp;
+            trackArrival(imu_stream_, stamp, config->raw_imu_rate);
+            snapshot_.store(writer_snapshot_);
+            // Samples of unused streams only update the snapshot
+            if(imu_stream_.demanded)
+            {
+                imu_stream_.pickup_latency.record(pickup_time - packet.receive_time);
+                dispatchImu(RawImuSample{stamp, writer_snapshot_.raw_imu, pickup_time});
+            }
+            break;
+        case MAVLINK_MSG_ID_MOUNT_STATUS:
+            packet.decode(writer_snapshot_.mount_status);
+            pickup_time = monotonicNanoseconds();
+            writer_snapshot_.stamps.mount_status = stamp;
+            trackArrival(encoder_stream_, stamp, config->mount_status_rate);
+            snapshot_.store(writer_snapshot_);
+            if(encoder_stream_.demanded)
+            {
+                encoder_stream_.pickup_latency.record(pickup_time - packet.receive_time);
+                dispatchEncoder(MountStatusSample{stamp, writer_snapshot_.mount_status, pickup_time});
+            }
+            break;
+        case MAVLINK_MSG_ID_MOUNT_ORIENTATION:
+            packet.decode(writer_snapshot_.mount_orientation);
+            pickup_time = monotonicNanoseconds();
+            writer_snapshot_.stamps.mount_orientation = stamp;
+            trackArrival(mount_orientation_stream_, stamp, config->mount_orientation_rate);
+            snapshot_.store(writer_snapshot_);
+            if(mount_orientation_stream_.demanded)
+            {
+                mount_orientation_stream_.pickup_latency.record(pickup_time - packet.receive_time);
+                dispatchMountOrientation(MountOrientationSample{stamp, writer_snapshot_.mount_orientation, pickup_time});
+            }
+            break;
+        default:
+            return false;
+    }
+
+    last_direct_stamp_ = stamp;
+    return true;
+}
+
+void GimbalNode::recordMessage(uint64_t stamp, const mavlink_message_t& message)
+{
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+    recorder_.record(stamp, ros::Time::now().toNSec(), buffer, length);
+}
+
+void GimbalNode::drainSampleQueues()
+{
+    RawImuSample imu_sample;
+    while(imu_queue_.pop(imu_sample))
+    {
+        publishImu(imu_sample);
+    }
+
+    MountStatusSample mount_status_sample;
+    while(mount_status_queue_.pop(mount_status_sample))
+    {
+        publishEncoder(mount_status_sample);
+    }
+
+    MountOrientationSample mount_orientation_sample;
+    while(mount_orientation_queue_.pop(mount_orientation_sample))
+    {
+        publishMountOrientation(mount_orientation_sample);
+    }
+}
+
+void GimbalNode::publishLatestSamples()
+{
+    GimbalSnapshot snapshot = snapshot_.load();
+    int64_t pickup_time = monotonicNanoseconds();
+    publishImu(RawImuSample{snapshot.stamps.raw_imu, snapshot.raw_imu, pickup_time});
+    publishEncoder(MountStatusSample{snapshot.stamps.mount_status, snapshot.mount_status, pickup_time});
+    publishMountOrientation(MountOrientationSample{snapshot.stamps.mount_orientation, snapshot.mount_orientation, pickup_time});
+}
+
+GimbalSnapshot GimbalNode::getSnapshot() const
+{
+    return snapshot_.load();
+}
+
+bool GimbalNode::claimSample(StreamState& stream, uint64_t stamp)
+{
+    // Nothing has been received yet
+    if(stamp == 0)
+    {
+        return false;
+    }
+
+    // Only a strictly newer sample is claimed, so neither a duplicate nor a sample the fallback timer read
+    // before the watcher published a newer one gets through. The compare exchange makes sure only one of the
+    // publishing threads gets the sample.
+    uint64_t last = stream.last_stamp.load();
+    do
+    {
+        // A much older stamp comes from a wall clock which was set back, not from a late sample
+        if(stamp <= last && last - stamp < STREAM_CLOCK_STEP)
+        {
+            stream.duplicates++;
+            return false;
+        }
+    }
+    while(!stream.last_stamp.compare_exchange_weak(last, stamp));
+
+    stream.published++;
+    return true;
+}
+
+void GimbalNode::publishImu(const RawImuSample& sample)
+{
+    ConfigConstPtr config = currentConfig();
+    if(!imu_stream_.demanded || !claimSample(imu_stream_, sample.stamp))
+    {
+        return;
+    }
+
+    int64_t start_time = monotonicNanoseconds();
+    imu_stream_.queue_latency.record(start_time - sample.pickup_time);
+
     // Publish Gimbal IMU
-    mavlink_raw_imu_t imu_mav = gimbal_interface_->get_gimbal_raw_imu();
-    imu_mav.time_usec = gimbal_interface_->get_gimbal_time_stamps().raw_imu; // TODO implement rostime
-    sensor_msgs::Imu imu_ros_mag = convertImuMavlinkMessageToROSMessage(imu_mav);
-    imu_pub.publish(imu_ros_mag);
+    const mavlink_raw_imu_t& imu_mav = sample.message;
+    sensor_msgs::ImuPtr imu_ros_mag = imu_pool_.acquire();
+    convertMavlink(imu_mav, *imu_ros_mag);
+
+    // Stamp with the sample time of the gimbal if it provides one, otherwise use the receive time
+    ros::Time receive_time = convertSDKTimeStampToROSTime(sample.stamp);
+    if(imu_mav.time_usec != 0)
+    {
+        imu_ros_mag->header.stamp = imu_clock_.update(imu_mav.time_usec, receive_time);
+    }
+    else
+    {
+        imu_ros_mag->header.stamp = receive_time;
+    }
+
+    if(config->imu_processing)
+    {
+        std::lock_guard<std::mutex> lock(imu_filter_mutex_);
+        imu_filter_.update(*imu_ros_mag);
+    }
+    else
+    {
+        // Recycled messages may still carry the estimate from before the processing was disabled
+        imu_ros_mag->orientation = geometry_msgs::Quaternion();
+        imu_ros_mag->orientation_covariance.fill(0.0);
+        imu_ros_mag->angular_velocity_covariance.fill(0.0);
+        imu_ros_mag->linear_acceleration_covariance.fill(0.0);
+    }
+
+    if(config->imu_batch)
+    {
+        batchImu(*imu_ros_mag);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gimbal_state_mutex_);
+        gimbal_state_.imu = *imu_ros_mag;
+        gimbal_state_imu_ = true;
+    }
+
+    int64_t converted_time = monotonicNanoseconds();
+    imu_stream_.conversion_time.record(converted_time - start_time);
+
+    // Published as shared pointer, the pool only reuses it after all subscribers released it
+    if(config->publish_legacy_topics)
+    {
+        imu_pub.publish(imu_ros_mag);
+    }
+    publishGimbalState();
+    imu_stream_.publish_time.record(monotonicNanoseconds() - converted_time);
+}
+
+void GimbalNode::batchImu(const sensor_msgs::Imu& imu_message)
+{
+    ConfigConstPtr config = currentConfig();
+    std::lock_guard<std::mutex> lock(imu_batch_mutex_);
+
+    if(!imu_batch_)
+    {
+        // Recycled batches keep the capacity of their sample vector
+        imu_batch_ = imu_batch_pool_.acquire();
+        imu_batch_->header.stamp = imu_message.header.stamp;
+        imu_batch_->samples.clear();
+        imu_batch_->samples.reserve(config->imu_batch_size);
+    }
+
+    imu_batch_->samples.emplace_back();
+    ros_gremsy::ImuSample& sample = imu_batch_->samples.back();
+    sample.stamp = imu_message.header.stamp;
+    sample.angular_velocity = imu_message.angular_velocity;
+    sample.linear_acceleration = imu_message.linear_acceleration;
+
+    // A batch is complete once it contains enough samples or spans the configured duration
+    bool full = imu_batch_->samples.size() >= (size_t) config->imu_batch_size;
+    bool expired = config->imu_batch_duration > 0.0 &&
+        (sample.stamp - imu_batch_->header.stamp).toSec() >= config->imu_batch_duration;
+
+    if(full || expired)
+    {
+        // Hand the batch over to the subscribers and start a new one with the next sample
+        imu_batch_pub.publish(ros_gremsy::ImuBatchConstPtr(imu_batch_));
+        imu_batch_.reset();
+    }
+}
+
+void GimbalNode::publishEncoder(const MountStatusSample& sample)
+{
+    ConfigConstPtr config = currentConfig();
+    if(!encoder_stream_.demanded || !claimSample(encoder_stream_, sample.stamp))
+    {
+        return;
+    }
+
+    int64_t start_time = monotonicNanoseconds();
+    encoder_stream_.queue_latency.record(start_time - sample.pickup_time);
 
     // Publish Gimbal Encoder Values
-    mavlink_mount_status_t mount_status = gimbal_interface_->get_gimbal_mount_status();
-    geometry_msgs::Vector3Stamped encoder_ros_msg;
-    encoder_ros_msg.header.stamp = ros::Time::now();
-    encoder_ros_msg.vector.x = ((float) mount_status.pointing_b) * DEG_TO_RAD;
-    encoder_ros_msg.vector.y = ((float) mount_status.pointing_a) * DEG_TO_RAD;
-    encoder_ros_msg.vector.z = ((float) mount_status.pointing_c) * DEG_TO_RAD;
-    // encoder_ros_msg.header TODO time stamps
-    
-    encoder_pub.publish(encoder_ros_msg);
+    const mavlink_mount_status_t& mount_status = sample.message;
+    geometry_msgs::Vector3StampedPtr encoder_ros_msg = encoder_pool_.acquire();
+    // The mount status carries no sample time, so the receive time is the closest estimate
+    encoder_ros_msg->header.stamp = convertSDKTimeStampToROSTime(sample.stamp);
+    convertMavlink(mount_status, encoder_ros_msg->vector);
+
+    // Differentiated on the node, where every sample is seen at the rate of the gimbal
+    double angles[3] = {encoder_ros_msg->vector.x, encoder_ros_msg->vector.y, encoder_ros_msg->vector.z};
+    double velocity[3];
+    bool velocity_estimated;
+    {
+        std::lock_guard<std::mutex> lock(velocity_estimator_mutex_);
+        velocity_estimated = velocity_estimator_.update(encoder_ros_msg->header.stamp, angles, velocity);
+    }
+    geometry_msgs::Vector3StampedPtr encoder_velocity_msg;
+    if(velocity_estimated)
+    {
+        encoder_velocity_msg = encoder_velocity_pool_.acquire();
+        encoder_velocity_msg->header.stamp = encoder_ros_msg->header.stamp;
+        encoder_velocity_msg->vector.x = velocity[0];
+        encoder_velocity_msg->vector.y = velocity[1];
+        encoder_velocity_msg->vector.z = velocity[2];
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gimbal_state_mutex_);
+        gimbal_state_.encoder_stamp = encoder_ros_msg->header.stamp;
+        gimbal_state_.encoder = encoder_ros_msg->vector;
+        if(encoder_velocity_msg)
+        {
+            gimbal_state_.encoder_velocity = encoder_velocity_msg->vector;
+        }
+        gimbal_state_encoder_ = true;
+    }
+
+    int64_t converted_time = monotonicNanoseconds();
+    encoder_stream_.conversion_time.record(converted_time - start_time);
+
+    if(config->publish_legacy_topics)
+    {
+        encoder_pub.publish(encoder_ros_msg);
+    }
+    if(encoder_velocity_msg)
+    {
+        encoder_velocity_pub.publish(encoder_velocity_msg);
+    }
+    updatePointGoal(*encoder_ros_msg);
+    publishGimbalState();
+    encoder_stream_.publish_time.record(monotonicNanoseconds() - converted_time);
+}
+
+void GimbalNode::publishMountOrientation(const MountOrientationSample& sample)
+{
+    ConfigConstPtr config = currentConfig();
+    if(!mount_orientation_stream_.demanded || !claimSample(mount_orientation_stream_, sample.stamp))
+    {
+        return;
+    }
+
+    int64_t start_time = monotonicNanoseconds();
+    mount_orientation_stream_.queue_latency.record(start_time - sample.pickup_time);
 
     // Get Mount Orientation
-    mavlink_mount_orientation_t mount_orientation = gimbal_interface_->get_gimbal_mount_orientation();
+    const mavlink_mount_orientation_t& mount_orientation = sample.message;
 
     // Publish Camera Mount Orientation in global frame (drifting)
-    tf2::Quaternion quat_abs;
-    quat_abs.setRPY(
-        DEG_TO_RAD * mount_orientation.roll,
-        DEG_TO_RAD * mount_orientation.pitch,
-        DEG_TO_RAD * mount_orientation.yaw_absolute);
-    quat_abs.normalize();
-
-    geometry_msgs::Quaternion quat_abs_msg;
-    tf2::convert(quat_abs , quat_abs_msg);
-    mount_orientation_incl_global_yaw.publish(quat_abs_msg);
+    geometry_msgs::QuaternionPtr quat_abs_msg = mount_orientation_global_pool_.acquire();
+    convertMavlink<GlobalYaw>(mount_orientation, *quat_abs_msg);
 
     // Publish Camera Mount Orientation in local frame (yaw relative to vehicle)
-    tf2::Quaternion quat_loc;
-    quat_loc.setRPY(
-        DEG_TO_RAD * mount_orientation.roll,
-        DEG_TO_RAD * mount_orientation.pitch,
-        DEG_TO_RAD * mount_orientation.yaw);
-    quat_loc.normalize();
+    geometry_msgs::QuaternionPtr quat_loc_msg = mount_orientation_local_pool_.acquire();
+    convertMavlink<LocalYaw>(mount_orientation, *quat_loc_msg);
+
+    // Stamp with the boot time of the gimbal if it provides one, otherwise use the receive time
+    ros::Time stamp = convertSDKTimeStampToROSTime(sample.stamp);
+    if(mount_orientation.time_boot_ms != 0)
+    {
+        stamp = mount_orientation_clock_.update(mount_orientation.time_boot_ms * 1000ULL, stamp);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gimbal_state_mutex_);
+        gimbal_state_.mount_orientation_stamp = stamp;
+        gimbal_state_.mount_orientation_local_yaw = *quat_loc_msg;
+        gimbal_state_.mount_orientation_global_yaw = *quat_abs_msg;
+    }
+
+    int64_t converted_time = monotonicNanoseconds();
+    mount_orientation_stream_.conversion_time.record(converted_time - start_time);
+
+    if(config->publish_legacy_topics)
+    {
+        mount_orientation_incl_global_yaw.publish(quat_abs_msg);
+        mount_orientation_incl_local_yaw.publish(quat_loc_msg);
+    }
+
+    if(config->publish_tf)
+    {
+        broadcastMountTransforms(stamp, *quat_loc_msg, *quat_abs_msg);
+    }
+    mount_orientation_stream_.publish_time.record(monotonicNanoseconds() - converted_time);
+}
+
+void GimbalNode::broadcastMountTransforms(
+    const ros::Time& stamp,
+    const geometry_msgs::Quaternion& local_yaw,
+    const geometry_msgs::Quaternion& global_yaw)
+{
+    tf2_msgs::TFMessagePtr message = tf_pool_.acquire();
+    {
+        std::lock_guard<std::mutex> lock(mount_transforms_mutex_);
+
+        // The frame ids are kept from the last reconfigure, only stamp and rotation change
+        mount_transforms_[0].header.stamp = stamp;
+        mount_transforms_[0].transform.rotation = local_yaw;
+        mount_transforms_[1].header.stamp = stamp;
+        mount_transforms_[1].transform.rotation = global_yaw;
+        // A recycled message keeps the capacity of its transforms and frame ids, so the copy does not allocate
+        message->transforms = mount_transforms_;
+    }
+    tf_pub.publish(message);
+}
+
+void GimbalNode::diagnosticsTimerCallback(const ros::TimerEvent& event)
+{
+    diagnostics_.update();
+}
+
+void GimbalNode::telemetryDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    ConfigConstPtr config = currentConfig();
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Streaming");
+    status.add("IMU subscribed", imu_stream_.demanded.load());
+    status.add("IMU published", imu_stream_.published.load());
+    status.add("IMU duplicates suppressed", imu_stream_.duplicates.load());
+    status.add("IMU queue overflows", imu_stream_.overflows.load());
+    status.add("IMU samples missed in the SDK", imu_stream_.missed.load());
+    if(config->imu_processing)
+    {
+        std::lock_guard<std::mutex> lock(imu_filter_mutex_);
+        const double* bias = imu_filter_.gyroBias();
+        status.addf("IMU gyro bias [rad/s]", "%.5f %.5f %.5f", bias[0], bias[1], bias[2]);
+    }
+    status.add("Encoder subscribed", encoder_stream_.demanded.load());
+    status.add("Encoder published", encoder_stream_.published.load());
+    status.add("Encoder duplicates suppressed", encoder_stream_.duplicates.load());
+    status.add("Encoder queue overflows", encoder_stream_.overflows.load());
+    status.add("Mount orientation subscribed", mount_orientation_stream_.demanded.load());
+    status.add("Mount orientation published", mount_orientation_stream_.published.load());
+    status.add("Mount orientation duplicates suppressed", mount_orientation_stream_.duplicates.load());
+    status.add("Mount orientation samples missed in the SDK", mount_orientation_stream_.missed.load());
+    status.add("Mount orientation queue overflows", mount_orientation_stream_.overflows.load());
+    if(recorder_.active())
+    {
+        status.add("Frames recorded", recorder_.records());
+        status.add("Frames dropped by the recorder", recorder_.dropped());
+        status.add("Log files written", recorder_.files());
+    }
+    status.add("Message allocations",
+        imu_pool_.allocations() + imu_batch_pool_.allocations() +
+        encoder_pool_.allocations() + encoder_velocity_pool_.allocations() +
+        mount_orientation_global_pool_.allocations() + mount_orientation_local_pool_.allocations() +
+        gimbal_state_pool_.allocations() + tf_pool_.allocations());
+}
 
-    geometry_msgs::Quaternion quat_loc_msg;
-    tf2::convert(quat_loc , quat_loc_msg);
-    mount_orientation_incl_local_yaw.publish(quat_loc_msg);
+// Appends the statistics of a histogram collected for the current period
+static void addStageStats(ros_gremsy::PipelineStats& stats, const std::string& stage, LatencyHistogram& histogram)
+{
+    LatencyHistogram::Summary summary = histogram.collect();
+    ros_gremsy::LatencyStats stage_stats;
+    stage_stats.stage = stage;
+    stage_stats.count = summary.count;
+    stage_stats.mean = summary.mean;
+    stage_stats.p50 = summary.p50;
+    stage_stats.p90 = summary.p90;
+    stage_stats.p99 = summary.p99;
+    stage_stats.max = summary.max;
+    stats.stages.push_back(stage_stats);
+}
+
+void GimbalNode::statsTimerCallback(const ros::TimerEvent& event)
+{
+    ros_gremsy::PipelineStatsPtr stats = boost::make_shared<ros_gremsy::PipelineStats>();
+    stats->header.stamp = ros::Time::now();
+
+    const std::pair<std::string, StreamState*> streams[] = {
+        {"imu", &imu_stream_},
+        {"encoder", &encoder_stream_},
+        {"mount_orientation", &mount_orientation_stream_}};
+    for(const auto& stream : streams)
+    {
+        addStageStats(*stats, stream.first + "/pickup", stream.second->pickup_latency);
+        addStageStats(*stats, stream.first + "/queue", stream.second->queue_latency);
+        addStageStats(*stats, stream.first + "/conversion", stream.second->conversion_time);
+        addStageStats(*stats, stream.first + "/publish", stream.second->publish_time);
+    }
+    addStageStats(*stats, "command/queue", command_queue_latency_);
+    addStageStats(*stats, "command/write", command_write_time_);
+
+    stats_pub.publish(stats);
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    last_stats_ = *stats;
+}
+
+void GimbalNode::latencyDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Timing of the last period");
+    for(const auto& stage : last_stats_.stages)
+    {
+        status.addf(stage.stage + " p50 / p99 / max [ms]", "%.3f / %.3f / %.3f",
+            stage.p50 * 1e3, stage.p99 * 1e3, stage.max * 1e3);
+    }
 }
 
 void GimbalNode::setGoalsCallback(geometry_msgs::Vector3Stamped message)
 {
-    gimbal_interface_->set_gimbal_move(
-        RAD_TO_DEG * message.vector.y,
-        RAD_TO_DEG * message.vector.x,
-        RAD_TO_DEG * message.vector.z);
+    // The axis modes are not set before, so the goal could be interpreted in the wrong frame
+    if(init_state_ != ros_gremsy::GimbalStatus::STREAMING)
+    {
+        ROS_WARN_THROTTLE(1.0, "Ignoring goal, the gimbal is not ready yet");
+        return;
+    }
+
+    // A goal takes over from an active trajectory
+    {
+        std::lock_guard<std::mutex> lock(trajectory_mutex_);
+        if(trajectory_.active())
+        {
+            ROS_INFO("Trajectory aborted by a goal");
+            trajectory_.clear();
+        }
+    }
+    abortPointGoal("Superseded by a goal");
+
+    submitAngles(message.vector);
 }
 
-sensor_msgs::Imu GimbalNode::convertImuMavlinkMessageToROSMessage(mavlink_raw_imu_t message)
+void GimbalNode::setRateGoalsCallback(geometry_msgs::Vector3Stamped message)
 {
-    sensor_msgs::Imu imu_message;
+    if(init_state_ != ros_gremsy::GimbalStatus::STREAMING)
+    {
+        ROS_WARN_THROTTLE(1.0, "Ignoring rate goal, the gimbal is not ready yet");
+        return;
+    }
+
+    // Rate goals take over from an active trajectory as well
+    {
+        std::lock_guard<std::mutex> lock(trajectory_mutex_);
+        if(trajectory_.active())
+        {
+            ROS_INFO("Trajectory aborted by a rate goal");
+            trajectory_.clear();
+        }
+    }
+    abortPointGoal("Superseded by a rate goal");
+
+    GimbalCommand command;
+    command.tilt = RAD_TO_DEG * message.vector.y;
+    command.roll = RAD_TO_DEG * message.vector.x;
+    command.pan = RAD_TO_DEG * message.vector.z;
+    command.rate = true;
+    command.submit_time = monotonicNanoseconds();
+    submitCommand(command);
+}
 
-    // Set accelaration data
-    imu_message.linear_acceleration.x = message.xacc;
-    imu_message.linear_acceleration.y = message.yacc;
-    imu_message.linear_acceleration.z = message.zacc;
+void GimbalNode::trajectoryCallback(const ros_gremsy::GimbalTrajectoryConstPtr& message)
+{
+    if(init_state_ != ros_gremsy::GimbalStatus::STREAMING)
+    {
+        ROS_WARN_THROTTLE(1.0, "Ignoring trajectory, the gimbal is not ready yet");
+        return;
+    }
 
-    // Set gyro data
-    imu_message.angular_velocity.x = message.xgyro;
-    imu_message.angular_velocity.y = message.ygyro;
-    imu_message.angular_velocity.z = message.zgyro;
+    abortPointGoal("Superseded by a trajectory");
 
-    return imu_message;
+    // The timer is started under the lock, so it can not be stopped by the end of the previous trajectory
+    std::lock_guard<std::mutex> lock(trajectory_mutex_);
+    std::string error;
+    if(!trajectory_.set(*message, ros::Time::now(), error))
+    {
+        ROS_WARN("Ignoring trajectory, %s", error.c_str());
+        return;
+    }
+    trajectories_received_++;
+    trajectory_timer_.start();
+}
+
+void GimbalNode::trajectoryTimerCallback(const ros::TimerEvent& event)
+{
+    geometry_msgs::Vector3 angles;
+    {
+        std::lock_guard<std::mutex> lock(trajectory_mutex_);
+        if(!trajectory_.sample(ros::Time::now(), angles))
+        {
+            // Finished or aborted, the timer is started again with the next trajectory
+            trajectory_timer_.stop();
+            return;
+        }
+    }
+
+    submitAngles(angles);
+}
+
+void GimbalNode::pointGoalCallback(PointGimbalServer::GoalHandle goal_handle)
+{
+    ConfigConstPtr config = currentConfig();
+    if(init_state_ != ros_gremsy::GimbalStatus::STREAMING)
+    {
+        goal_handle.setRejected(ros_gremsy::PointGimbalResult(), "The gimbal is not ready yet");
+        return;
+    }
+
+    const ros_gremsy::PointGimbalGoal& goal = *goal_handle.getGoal();
+    {
+        std::lock_guard<std::mutex> lock(trajectory_mutex_);
+        if(trajectory_.active())
+        {
+            ROS_INFO("Trajectory aborted by a point goal");
+            trajectory_.clear();
+        }
+    }
+
+    double timeout = goal.timeout.toSec() > 0.0 ? goal.timeout.toSec() : config->point_timeout;
+    PointGimbalServer::GoalHandle previous_goal;
+    ros_gremsy::PointGimbalFeedback previous_feedback;
+    bool preempted;
+    {
+        std::lock_guard<std::mutex> lock(point_mutex_);
+        preempted = point_active_;
+        previous_goal = point_goal_;
+        previous_feedback = point_feedback_;
+        point_goal_ = goal_handle;
+        point_target_ = goal.angles;
+        point_tolerance_ = goal.tolerance > 0.0 ? goal.tolerance : config->point_tolerance;
+        point_start_ = ros::Time::now();
+        point_deadline_ = timeout > 0.0 ? point_start_ + ros::Duration(timeout) : ros::Time();
+        point_settled_since_ = ros::Time();
+        point_feedback_ = ros_gremsy::PointGimbalFeedback();
+        point_active_ = true;
+        point_goals_received_++;
+        if(preempted)
+        {
+            point_goals_canceled_++;
+        }
+    }
+    if(preempted)
+    {
+        previous_goal.setCanceled(pointResult(previous_feedback), "Preempted by a new goal");
+    }
+    goal_handle.setAccepted();
+
+    // A oneshot timer is restarted by stopping it first
+    point_timer_.stop();
+    if(timeout > 0.0)
+    {
+        point_timer_.setPeriod(ros::Duration(timeout));
+        point_timer_.start();
+    }
+
+    // The encoder stream is needed at its full rate to track the goal
+    applyStreamDemand();
+    submitAngles(goal.angles);
+}
+
+void GimbalNode::pointCancelCallback(PointGimbalServer::GoalHandle goal_handle)
+{
+    ros_gremsy::PointGimbalFeedback feedback;
+    {
+        std::lock_guard<std::mutex> lock(point_mutex_);
+        if(!point_active_ || point_goal_ != goal_handle)
+        {
+            return;
+        }
+        point_active_ = false;
+        point_goals_canceled_++;
+        feedback = point_feedback_;
+    }
+    point_timer_.stop();
+
+    // The gimbal keeps moving towards the last goal it was sent
+    goal_handle.setCanceled(pointResult(feedback), "Canceled");
+    applyStreamDemand();
+}
+
+void GimbalNode::pointTimeoutCallback(const ros::TimerEvent& event)
+{
+    PointGimbalServer::GoalHandle goal_handle;
+    ros_gremsy::PointGimbalFeedback feedback;
+    {
+        std::lock_guard<std::mutex> lock(point_mutex_);
+        // A timeout which was already queued can belong to a previous goal
+        if(!point_active_ || point_deadline_.isZero() || ros::Time::now() < point_deadline_)
+        {
+            return;
+        }
+        point_active_ = false;
+        point_goals_aborted_++;
+        goal_handle = point_goal_;
+        feedback = point_feedback_;
+    }
+
+    ROS_WARN("Point goal aborted, the gimbal is still %.3f rad away", feedback.distance);
+    goal_handle.setAborted(pointResult(feedback), "Timed out");
+    applyStreamDemand();
+}
+
+void GimbalNode::updatePointGoal(const geometry_msgs::Vector3Stamped& encoder)
+{
+    ConfigConstPtr config = currentConfig();
+    if(!point_active_)
+    {
+        return;
+    }
+
+    PointGimbalServer::GoalHandle goal_handle;
+    ros_gremsy::PointGimbalFeedback feedback;
+    bool reached = false;
+    {
+        std::lock_guard<std::mutex> lock(point_mutex_);
+        // Samples which were received before the goal do not show its progress
+        if(!point_active_ || encoder.header.stamp < point_start_)
+        {
+            return;
+        }
+
+        // The errors are wrapped, so a pan goal near +-pi is not reported the long way round
+        feedback.angles = encoder.vector;
+        feedback.error.x = std::remainder(point_target_.x - encoder.vector.x, 2.0 * M_PI);
+        feedback.error.y = std::remainder(point_target_.y - encoder.vector.y, 2.0 * M_PI);
+        feedback.error.z = std::remainder(point_target_.z - encoder.vector.z, 2.0 * M_PI);
+        feedback.distance = std::max(std::fabs(feedback.error.x),
+            std::max(std::fabs(feedback.error.y), std::fabs(feedback.error.z)));
+        point_feedback_ = feedback;
+
+        // The goal is reached once the gimbal stayed within the tolerance for the settle time, so an overshoot does not count
+        if(feedback.distance <= point_tolerance_)
+        {
+            if(point_settled_since_.isZero())
+            {
+                point_settled_since_ = encoder.header.stamp;
+            }
+            reached = (encoder.header.stamp - point_settled_since_).toSec() >= config->point_settle_time;
+        }
+        else
+        {
+            point_settled_since_ = ros::Time();
+        }
+
+        if(reached)
+        {
+            point_active_ = false;
+            point_goals_succeeded_++;
+        }
+        goal_handle = point_goal_;
+    }
+
+    // The action server is called without the point mutex, it holds a lock of its own while calling the goal callbacks
+    if(reached)
+    {
+        point_timer_.stop();
+        goal_handle.setSucceeded(pointResult(feedback), "Goal reached");
+        applyStreamDemand();
+    }
+    else
+    {
+        goal_handle.publishFeedback(feedback);
+    }
+}
+
+void GimbalNode::abortPointGoal(const std::string& reason)
+{
+    PointGimbalServer::GoalHandle goal_handle;
+    ros_gremsy::PointGimbalFeedback feedback;
+    {
+        std::lock_guard<std::mutex> lock(point_mutex_);
+        if(!point_active_)
+        {
+            return;
+        }
+        point_active_ = false;
+        point_goals_aborted_++;
+        goal_handle = point_goal_;
+        feedback = point_feedback_;
+    }
+    point_timer_.stop();
+
+    ROS_INFO("Point goal aborted, %s", reason.c_str());
+    goal_handle.setAborted(pointResult(feedback), reason);
+    applyStreamDemand();
+}
+
+void GimbalNode::submitAngles(const geometry_msgs::Vector3& angles)
+{
+    GimbalCommand command;
+    command.tilt = RAD_TO_DEG * angles.y;
+    command.roll = RAD_TO_DEG * angles.x;
+    command.pan = RAD_TO_DEG * angles.z;
+    command.submit_time = monotonicNanoseconds();
+    submitCommand(command);
+}
+
+void GimbalNode::submitCommand(const GimbalCommand& command)
+{
+    {
+        std::lock_guard<std::mutex> lock(command_mutex_);
+        // A command which has not been sent yet is superseded by the new one
+        if(command_pending_)
+        {
+            commands_coalesced_++;
+        }
+        pending_command_ = command;
+        command_pending_ = true;
+        commands_received_++;
+    }
+    command_cv_.notify_one();
+}
+
+void GimbalNode::commandWriterLoop()
+{
+    ConfigConstPtr config = currentConfig();
+    applyThreadScheduling(command_scheduling_, "command writer thread");
+
+    std::unique_lock<std::mutex> lock(command_mutex_);
+    std::chrono::steady_clock::time_point next_send = std::chrono::steady_clock::now();
+
+    while(command_writer_running_)
+    {
+        // Reconfigured values are picked up with every command
+        config = currentConfig();
+        auto woken = [this]{ return command_pending_ || gimbal_mode_changed_ || axes_changed_ || !command_writer_running_; };
+
+        // The gimbal keeps turning with the last rate, so it is stopped if the rate goals stop arriving
+        if(rate_moving_ && config->rate_timeout > 0.0)
+        {
+            if(!command_cv_.wait_until(lock, rate_deadline_, woken))
+            {
+                ROS_WARN("No rate goal received for %.2f s, stopping the gimbal", config->rate_timeout);
+                pending_command_ = GimbalCommand();
+                pending_command_.rate = true;
+                pending_command_.submit_time = monotonicNanoseconds();
+                command_pending_ = true;
+                rate_stops_++;
+            }
+        }
+        else
+        {
+            command_cv_.wait(lock, woken);
+        }
+
+        if(!command_writer_running_)
+        {
+            break;
+        }
+
+        // Reconfigured modes are sent between two commands, so they keep their order on the serial link
+        if(gimbal_mode_changed_ || axes_changed_)
+        {
+            bool gimbal_mode_changed = gimbal_mode_changed_, axes_changed = axes_changed_;
+            bool rate_control = rate_control_;
+            gimbal_mode_changed_ = false;
+            axes_changed_ = false;
+
+            lock.unlock();
+            if(gimbal_mode_changed)
+            {
+                gimbal_interface_->set_gimbal_mode(convertIntGimbalMode(config->gimbal_mode));
+            }
+            if(axes_changed)
+            {
+                configureAxes(rate_control);
+            }
+            lock.lock();
+            continue;
+        }
+
+        // Respect the maximum command rate, newer commands replace the pending one in the meantime
+        if(std::chrono::steady_clock::now() < next_send)
+        {
+            command_cv_.wait_until(lock, next_send, [this]{ return !command_writer_running_; });
+            continue;
+        }
+
+        GimbalCommand command = pending_command_;
+        command_pending_ = false;
+        bool switch_axes = command.rate != rate_control_;
+        rate_control_ = command.rate;
+
+        // Do not hold the lock during the serial write, so new commands can be queued
+        lock.unlock();
+        int64_t write_start = monotonicNanoseconds();
+        command_queue_latency_.record(write_start - command.submit_time);
+        // The SDK sends angles and rates by the same call, the axis input modes tell the gimbal how to read them
+        if(switch_axes)
+        {
+            configureAxes(command.rate);
+        }
+        gimbal_interface_->set_gimbal_move(command.tilt, command.roll, command.pan);
+        command_write_time_.record(monotonicNanoseconds() - write_start);
+        lock.lock();
+        commands_sent_++;
+
+        rate_moving_ = command.rate && (command.tilt != 0.0f || command.roll != 0.0f || command.pan != 0.0f);
+        if(rate_moving_ && config->rate_timeout > 0.0)
+        {
+            rate_deadline_ = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(config->rate_timeout));
+        }
+
+        if(config->command_rate > 0.0)
+        {
+            next_send = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(1.0 / config->command_rate));
+        }
+    }
+}
+
+void GimbalNode::commandDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    std::lock_guard<std::mutex> lock(command_mutex_);
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Ready");
+    status.add("Commands received", commands_received_);
+    status.add("Commands sent", commands_sent_);
+    status.add("Commands coalesced", commands_coalesced_);
+    status.add("Rate control", rate_control_);
+    status.add("Stops after rate timeout", rate_stops_);
+
+    std::lock_guard<std::mutex> trajectory_lock(trajectory_mutex_);
+    status.add("Trajectories received", trajectories_received_);
+    status.add("Trajectory active", trajectory_.active());
+
+    std::lock_guard<std::mutex> point_lock(point_mutex_);
+    status.add("Point goals received", point_goals_received_);
+    status.add("Point goals succeeded", point_goals_succeeded_);
+    status.add("Point goals aborted", point_goals_aborted_);
+    status.add("Point goals canceled", point_goals_canceled_);
+    status.add("Point goal active", point_active_.load());
+}
+
+ros::Time GimbalNode::convertSDKTimeStampToROSTime(uint64_t stamp)
+{
+    ros::Time time;
+    time.fromNSec(stamp * 1000);
+    return time;
 }
 
 control_gimbal_mode_t GimbalNode::convertIntGimbalMode(int mode)
@@ -166,17 +1765,127 @@ control_gimbal_axis_input_mode_t GimbalNode::convertIntToAxisInputMode(int mode)
     }
 }
 
-void GimbalNode::reconfigureCallback(ros_gremsy::ROSGremsyConfig &config, uint32_t level) {
-    config_ = config;
+ConfigConstPtr GimbalNode::currentConfig() const
+{
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    return config_;
 }
 
-int main(int argc, char **argv)
-{
-    // Init
-    ros::init(argc, argv, "ros_gremsy");
-    ros::NodeHandle nh;
-    ros::NodeHandle pnh("~");
-    GimbalNode n(nh, pnh);
+void GimbalNode::reconfigureCallback(ros_gremsy::ROSGremsyConfig &config, uint32_t level) {
+    // The first call from the constructor compares against itself, nothing exists yet which would have to be updated
+    ConfigConstPtr previous = currentConfig();
+    if(!previous)
+    {
+        previous = std::make_shared<const ros_gremsy::ROSGremsyConfig>(config);
+    }
+    bool stream_rates_changed =
+        config.raw_imu_rate != previous->raw_imu_rate ||
+        config.mount_status_rate != previous->mount_status_rate ||
+        config.mount_orientation_rate != previous->mount_orientation_rate ||
+        config.idle_stream_rate != previous->idle_stream_rate;
+    bool gimbal_mode_changed = config.gimbal_mode != previous->gimbal_mode;
+    bool axes_changed =
+        config.tilt_axis_input_mode != previous->tilt_axis_input_mode ||
+        config.roll_axis_input_mode != previous->roll_axis_input_mode ||
+        config.pan_axis_input_mode != previous->pan_axis_input_mode ||
+        config.tilt_axis_stabilize != previous->tilt_axis_stabilize ||
+        config.roll_axis_stabilize != previous->roll_axis_stabilize ||
+        config.pan_axis_stabilize != previous->pan_axis_stabilize;
+    bool state_poll_rate_changed = config.state_poll_rate != previous->state_poll_rate;
+    bool trajectory_rate_changed = config.trajectory_rate != previous->trajectory_rate;
+    bool stats_period_changed = config.stats_period != previous->stats_period;
+    bool time_sync_window_changed = config.time_sync_window != previous->time_sync_window;
+    bool imu_processing_enabled = config.imu_processing && !previous->imu_processing;
 
-    return 0;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        config_ = std::make_shared<const ros_gremsy::ROSGremsyConfig>(config);
+    }
+
+    // The first call comes from the constructor before the timers exist, they are created with the config afterwards
+    if(state_poll_rate_changed && state_timer_.isValid())
+    {
+        state_timer_.setPeriod(ros::Duration(1/config.state_poll_rate));
+    }
+    if(trajectory_rate_changed && trajectory_timer_.isValid())
+    {
+        trajectory_timer_.setPeriod(ros::Duration(1/config.trajectory_rate));
+    }
+    if(stats_period_changed && stats_timer_.isValid())
+    {
+        stats_timer_.setPeriod(ros::Duration(config.stats_period));
+    }
+    if(time_sync_window_changed)
+    {
+        imu_clock_.setWindowSize(config.time_sync_window);
+        mount_orientation_clock_.setWindowSize(config.time_sync_window);
+    }
+
+    {
+        VelocityEstimator::Parameters parameters;
+        parameters.method = config.encoder_velocity_estimator;
+        parameters.process_noise = config.encoder_velocity_process_noise;
+        parameters.measurement_noise = config.encoder_velocity_measurement_noise;
+
+        std::lock_guard<std::mutex> lock(velocity_estimator_mutex_);
+        velocity_estimator_.configure(parameters);
+    }
+
+    // The filter keeps its state for parameter changes, only a restart of the processing starts from scratch
+    {
+        ImuFilter::Parameters parameters;
+        parameters.accel_scale = config.imu_accel_scale;
+        parameters.gyro_scale = config.imu_gyro_scale;
+        parameters.lowpass_cutoff = config.imu_lowpass_cutoff;
+        parameters.notch_frequency = config.imu_notch_frequency;
+        parameters.notch_bandwidth = config.imu_notch_bandwidth;
+        parameters.bias_time_constant = config.imu_bias_time_constant;
+        parameters.stationary_threshold = config.imu_stationary_threshold;
+        parameters.orientation_time_constant = config.imu_orientation_time_constant;
+        parameters.accel_noise = config.imu_accel_noise;
+        parameters.gyro_noise = config.imu_gyro_noise;
+        parameters.orientation_noise = config.imu_orientation_noise;
+
+        std::lock_guard<std::mutex> lock(imu_filter_mutex_);
+        imu_filter_.configure(parameters);
+        if(imu_processing_enabled)
+        {
+            imu_filter_.reset();
+        }
+    }
+
+    // Enabling or disabling outputs changes which streams are consumed
+    stream_rates_changed |= updateStreamDemand();
+
+    // Local yaw: camera relative to the gimbal mount, global yaw: camera relative to a gravity aligned frame
+    {
+        std::lock_guard<std::mutex> lock(mount_transforms_mutex_);
+        mount_transforms_.resize(2);
+        mount_transforms_[0].header.frame_id = config.base_frame_id;
+        mount_transforms_[0].child_frame_id = config.camera_frame_id;
+        mount_transforms_[1].header.frame_id = config.global_frame_id;
+        mount_transforms_[1].child_frame_id = config.camera_global_frame_id;
+    }
+
+    // The rates and modes are sent during the startup, afterwards only changes need to be sent
+    if(init_state_ != ros_gremsy::GimbalStatus::STREAMING)
+    {
+        return;
+    }
+
+    if(stream_rates_changed)
+    {
+        requestStreamRates();
+    }
+
+    // The modes are sent by the command writer, so they are not interleaved with a move command
+    if(gimbal_mode_changed || axes_changed)
+    {
+        {
+            std::lock_guard<std::mutex> lock(command_mutex_);
+            gimbal_mode_changed_ |= gimbal_mode_changed;
+            axes_changed_ |= axes_changed;
+        }
+        command_cv_.notify_one();
+    }
 }
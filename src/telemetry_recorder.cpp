@@ -0,0 +1,325 @@
+#include <ros_gremsy/telemetry_recorder.h>
+#include <ros/ros.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+
+// Records and frames are aligned to 8 bytes, so the record headers can be read in place
+static size_t padded(size_t length)
+{
+    return (length + 7) & ~static_cast<size_t>(7);
+}
+
+// Largest MAVLink 2 frame including the signature
+static constexpr size_t max_frame_length = 280;
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+    stop();
+}
+
+bool TelemetryRecorder::start(const std::string& prefix, size_t file_size, int max_files, std::string& error)
+{
+    if(active_)
+    {
+        error = "the recorder is already running";
+        return false;
+    }
+    if(file_size < sizeof(TelemetryLogHeader) + sizeof(TelemetryRecordHeader) + padded(max_frame_length))
+    {
+        error = "the file size of " + std::to_string(file_size) + " bytes can not hold a single frame";
+        return false;
+    }
+
+    // The start time keeps the files of consecutive runs apart
+    char start_time[32];
+    time_t now = time(nullptr);
+    tm local_time;
+    localtime_r(&now, &local_time);
+    strftime(start_time, sizeof(start_time), "%Y%m%d-%H%M%S", &local_time);
+    prefix_ = prefix + "_" + start_time;
+    file_size_ = file_size;
+    max_files_ = max_files;
+    file_index_ = 0;
+    finished_paths_.clear();
+
+    // The first file is opened right away, so a wrong path is reported to the caller
+    if(!openFile(current_, error))
+    {
+        return false;
+    }
+
+    maintenance_running_ = true;
+    maintenance_thread_ = std::thread(&TelemetryRecorder::maintenanceLoop, this);
+    active_ = true;
+    return true;
+}
+
+void TelemetryRecorder::stop()
+{
+    if(!active_)
+    {
+        return;
+    }
+    active_ = false;
+
+    // A pending full file is still finished by the maintenance thread before it stops
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maintenance_running_ = false;
+    }
+    cv_.notify_all();
+    maintenance_thread_.join();
+
+    closeFile(current_);
+    if(next_ready_)
+    {
+        // The prepared file has never been written
+        closeFile(next_);
+        unlink(next_.path.c_str());
+        next_ready_ = false;
+    }
+}
+
+void TelemetryRecorder::record(uint64_t receive_stamp, int64_t ros_time, const uint8_t* frame, size_t length)
+{
+    size_t needed = sizeof(TelemetryRecordHeader) + padded(length);
+    if((!current_.data || current_.used + needed > file_size_) && !rotate())
+    {
+        dropped_++;
+        return;
+    }
+
+    uint8_t* destination = current_.data + current_.used;
+    TelemetryRecordHeader header{0, 0, receive_stamp, ros_time};
+    memcpy(destination + sizeof(header), frame, length);
+    memcpy(destination, &header, sizeof(header));
+    // The length is written last, so a crash never leaves a record which looks complete but is not
+    std::atomic_signal_fence(std::memory_order_release);
+    uint32_t frame_length = length;
+    memcpy(destination, &frame_length, sizeof(frame_length));
+
+    current_.used += needed;
+    records_++;
+}
+
+bool TelemetryRecorder::rotate()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!next_ready_)
+    {
+        return false;
+    }
+    finished_ = current_;
+    finished_pending_ = true;
+    current_ = next_;
+    next_ = MappedFile();
+    next_ready_ = false;
+    cv_.notify_one();
+    return true;
+}
+
+bool TelemetryRecorder::openFile(MappedFile& file, std::string& error)
+{
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "_%04d.tlm", file_index_++);
+    file.path = prefix_ + suffix;
+
+    file.fd = ::open(file.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(file.fd < 0)
+    {
+        error = "can not open " + file.path + ": " + strerror(errno);
+        return false;
+    }
+
+    // Allocating the blocks up front turns a full disk into an error here instead of a SIGBUS while recording
+    int result = posix_fallocate(file.fd, 0, file_size_);
+    if(result != 0)
+    {
+        error = "can not allocate " + file.path + ": " + strerror(result);
+        ::close(file.fd);
+        unlink(file.path.c_str());
+        file.fd = -1;
+        return false;
+    }
+
+    // Populated, so the recording thread does not take a page fault with every new page
+    void* data = mmap(nullptr, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, file.fd, 0);
+    if(data == MAP_FAILED)
+    {
+        error = "can not map " + file.path + ": " + strerror(errno);
+        ::close(file.fd);
+        unlink(file.path.c_str());
+        file.fd = -1;
+        return false;
+    }
+    file.data = static_cast<uint8_t*>(data);
+
+    TelemetryLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TELEMETRY_LOG_MAGIC, sizeof(header.magic));
+    header.version = TELEMETRY_LOG_VERSION;
+    header.header_size = sizeof(header);
+    header.created = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    memcpy(file.data, &header, sizeof(header));
+    file.used = sizeof(header);
+
+    files_++;
+    return true;
+}
+
+void TelemetryRecorder::closeFile(MappedFile& file)
+{
+    if(file.data)
+    {
+        munmap(file.data, file_size_);
+        file.data = nullptr;
+    }
+    if(file.fd >= 0)
+    {
+        // Drops the preallocated rest, the log simply ends with the file
+        if(ftruncate(file.fd, file.used) != 0)
+        {
+            ROS_WARN("Can not truncate the telemetry log %s: %s", file.path.c_str(), strerror(errno));
+        }
+        ::close(file.fd);
+        file.fd = -1;
+    }
+}
+
+void TelemetryRecorder::maintenanceLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true)
+    {
+        cv_.wait(lock, [this]{ return finished_pending_ || !next_ready_ || !maintenance_running_; });
+
+        if(finished_pending_)
+        {
+            MappedFile file = finished_;
+            finished_ = MappedFile();
+            finished_pending_ = false;
+            lock.unlock();
+
+            closeFile(file);
+            // The file being written counts towards the maximum as well
+            finished_paths_.push_back(file.path);
+            while(max_files_ > 0 && finished_paths_.size() + 1 > static_cast<size_t>(max_files_))
+            {
+                unlink(finished_paths_.front().c_str());
+                finished_paths_.pop_front();
+            }
+
+            lock.lock();
+            continue;
+        }
+
+        if(!maintenance_running_)
+        {
+            break;
+        }
+
+        // Prepare the next file while the current one is filled
+        lock.unlock();
+        MappedFile file;
+        std::string error;
+        bool opened = openFile(file, error);
+        lock.lock();
+
+        if(opened)
+        {
+            next_ = file;
+            next_ready_ = true;
+        }
+        else
+        {
+            ROS_ERROR_THROTTLE(10.0, "Can not prepare the next telemetry log, %s", error.c_str());
+            cv_.wait_for(lock, std::chrono::seconds(1), [this]{ return finished_pending_ || !maintenance_running_; });
+        }
+    }
+}
+
+TelemetryLogReader::~TelemetryLogReader()
+{
+    close();
+}
+
+bool TelemetryLogReader::open(const std::string& path, std::string& error)
+{
+    close();
+
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd_ < 0)
+    {
+        error = "can not open " + path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat status;
+    if(fstat(fd_, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(TelemetryLogHeader))
+    {
+        error = path + " is not a telemetry log";
+        close();
+        return false;
+    }
+    size_ = status.st_size;
+
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(data == MAP_FAILED)
+    {
+        error = "can not map " + path + ": " + strerror(errno);
+        size_ = 0;
+        close();
+        return false;
+    }
+    data_ = static_cast<const uint8_t*>(data);
+
+    TelemetryLogHeader header;
+    memcpy(&header, data_, sizeof(header));
+    if(memcmp(header.magic, TELEMETRY_LOG_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TELEMETRY_LOG_VERSION || header.header_size < sizeof(header) || header.header_size > size_)
+    {
+        error = path + " is not a telemetry log of version " + std::to_string(TELEMETRY_LOG_VERSION);
+        close();
+        return false;
+    }
+    offset_ = header.header_size;
+    return true;
+}
+
+void TelemetryLogReader::close()
+{
+    if(data_)
+    {
+        munmap(const_cast<uint8_t*>(data_), size_);
+        data_ = nullptr;
+    }
+    if(fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+    offset_ = 0;
+}
+
+bool TelemetryLogReader::next(TelemetryRecordHeader& record, const uint8_t*& frame)
+{
+    if(!data_ || offset_ + sizeof(record) > size_)
+    {
+        return false;
+    }
+    memcpy(&record, data_ + offset_, sizeof(record));
+    // A zero length marks the unwritten rest of a file which has not been finished
+    if(record.length == 0 || offset_ + sizeof(record) + record.length > size_)
+    {
+        return false;
+    }
+    frame = data_ + offset_ + sizeof(record);
+    offset_ += sizeof(record) + padded(record.length);
+    return true;
+}
@@ -0,0 +1,150 @@
+#include <ros_gremsy/thread_scheduling.h>
+#include <ros/ros.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstdlib>
+
+bool parseCpuList(const std::string& list, std::vector<int>& cpus, std::string& error)
+{
+    cpus.clear();
+    size_t start = 0;
+    while(start < list.size())
+    {
+        size_t end = list.find(',', start);
+        if(end == std::string::npos)
+        {
+            end = list.size();
+        }
+        std::string range = list.substr(start, end - start);
+        start = end + 1;
+
+        // Either a single CPU or a range of CPUs like 0-3
+        char* rest;
+        long first = strtol(range.c_str(), &rest, 10);
+        bool valid = rest != range.c_str();
+        long last = first;
+        if(valid && *rest == '-')
+        {
+            const char* second = rest + 1;
+            last = strtol(second, &rest, 10);
+            valid = rest != second;
+        }
+        if(!valid || *rest != '\0' || first < 0 || last < first || last >= CPU_SETSIZE)
+        {
+            error = "invalid CPU \"" + range + "\" in \"" + list + "\"";
+            cpus.clear();
+            return false;
+        }
+        for(long cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return true;
+}
+
+bool applyThreadScheduling(const ThreadScheduling& scheduling, std::string& error)
+{
+    error.clear();
+
+    if(!scheduling.cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu : scheduling.cpus)
+        {
+            CPU_SET(cpu, &set);
+        }
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if(result != 0)
+        {
+            error = std::string("can not set the CPU affinity: ") + strerror(result);
+        }
+    }
+
+    if(scheduling.priority > 0)
+    {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = scheduling.priority;
+        int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(result != 0)
+        {
+            error += std::string(error.empty() ? "" : ", ") + "can not set SCHED_FIFO priority " +
+                std::to_string(scheduling.priority) + ": " + strerror(result);
+        }
+    }
+    return error.empty();
+}
+
+std::string describeThreadScheduling()
+{
+    std::string description;
+    int policy;
+    sched_param param;
+    if(pthread_getschedparam(pthread_self(), &policy, &param) == 0)
+    {
+        switch(policy)
+        {
+        case SCHED_FIFO:
+            description = "SCHED_FIFO priority " + std::to_string(param.sched_priority);
+            break;
+        case SCHED_RR:
+            description = "SCHED_RR priority " + std::to_string(param.sched_priority);
+            break;
+        default:
+            description = "SCHED_OTHER";
+            break;
+        }
+    }
+    else
+    {
+        description = "unknown scheduler";
+    }
+
+    // The CPUs are listed as ranges, e.g. 0-3,6
+    cpu_set_t set;
+    if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+    {
+        std::string cpus;
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if(!CPU_ISSET(cpu, &set))
+            {
+                continue;
+            }
+            int last = cpu;
+            while(last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set))
+            {
+                last++;
+            }
+            cpus += (cpus.empty() ? "" : ",") + std::to_string(cpu) + (last > cpu ? "-" + std::to_string(last) : "");
+            cpu = last;
+        }
+        description += " on CPUs " + cpus;
+    }
+    return description;
+}
+
+bool lockProcessMemory(std::string& error)
+{
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        error = std::string("can not lock the memory: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void applyThreadScheduling(const ThreadScheduling& scheduling, const std::string& name)
+{
+    std::string error;
+    if(!applyThreadScheduling(scheduling, error))
+    {
+        ROS_WARN("Can not schedule the %s as configured, %s", name.c_str(), error.c_str());
+    }
+    ROS_INFO("The %s runs with %s", name.c_str(), describeThreadScheduling().c_str());
+}
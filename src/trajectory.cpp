@@ -0,0 +1,120 @@
+#include <ros_gremsy/trajectory.h>
+
+bool Trajectory::set(const ros_gremsy::GimbalTrajectory& trajectory, const ros::Time& receive_time, std::string& error)
+{
+    if(trajectory.points.empty())
+    {
+        error = "the trajectory contains no waypoints";
+        return false;
+    }
+
+    for(size_t i = 1; i < trajectory.points.size(); i++)
+    {
+        if(!(trajectory.points[i].time_from_start > trajectory.points[i - 1].time_from_start))
+        {
+            error = "the waypoints are not ordered by strictly increasing time";
+            return false;
+        }
+    }
+
+    knots_.resize(trajectory.points.size());
+    for(size_t i = 0; i < knots_.size(); i++)
+    {
+        const geometry_msgs::Vector3& angles = trajectory.points[i].angles;
+        knots_[i].time = trajectory.points[i].time_from_start.toSec();
+        knots_[i].position[0] = angles.x;
+        knots_[i].position[1] = angles.y;
+        knots_[i].position[2] = angles.z;
+    }
+
+    // The first and the last waypoint are passed at rest, the others with the slope between their neighbours
+    for(size_t i = 0; i < knots_.size(); i++)
+    {
+        for(int axis = 0; axis < 3; axis++)
+        {
+            if(i == 0 || i + 1 == knots_.size())
+            {
+                knots_[i].velocity[axis] = 0.0;
+            }
+            else
+            {
+                knots_[i].velocity[axis] =
+                    (knots_[i + 1].position[axis] - knots_[i - 1].position[axis]) /
+                    (knots_[i + 1].time - knots_[i - 1].time);
+            }
+        }
+    }
+
+    start_ = trajectory.header.stamp.isZero() ? receive_time : trajectory.header.stamp;
+    segment_ = 0;
+    return true;
+}
+
+void Trajectory::clear()
+{
+    knots_.clear();
+}
+
+bool Trajectory::active() const
+{
+    return !knots_.empty();
+}
+
+bool Trajectory::sample(const ros::Time& time, geometry_msgs::Vector3& angles)
+{
+    if(knots_.empty())
+    {
+        return false;
+    }
+
+    double t = (time - start_).toSec();
+    double position[3];
+
+    if(t <= knots_.front().time)
+    {
+        std::copy(knots_.front().position, knots_.front().position + 3, position);
+    }
+    else if(t >= knots_.back().time)
+    {
+        // Send the last waypoint once, the trajectory is finished afterwards
+        std::copy(knots_.back().position, knots_.back().position + 3, position);
+        knots_.clear();
+    }
+    else
+    {
+        // Start the search from the last segment, it only moves forward during a trajectory
+        if(knots_[segment_].time > t)
+        {
+            segment_ = 0;
+        }
+        while(knots_[segment_ + 1].time < t)
+        {
+            segment_++;
+        }
+
+        const Knot& a = knots_[segment_];
+        const Knot& b = knots_[segment_ + 1];
+        double h = b.time - a.time;
+        double s = (t - a.time) / h;
+        double s2 = s * s;
+        double s3 = s2 * s;
+
+        // Cubic Hermite basis functions
+        double h00 = 2 * s3 - 3 * s2 + 1;
+        double h10 = s3 - 2 * s2 + s;
+        double h01 = -2 * s3 + 3 * s2;
+        double h11 = s3 - s2;
+
+        for(int axis = 0; axis < 3; axis++)
+        {
+            position[axis] =
+                h00 * a.position[axis] + h10 * h * a.velocity[axis] +
+                h01 * b.position[axis] + h11 * h * b.velocity[axis];
+        }
+    }
+
+    angles.x = position[0];
+    angles.y = position[1];
+    angles.z = position[2];
+    return true;
+}
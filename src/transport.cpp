@@ -0,0 +1,508 @@
+#include <ros_gremsy/transport.h>
+#include <ros/ros.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/serial.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include <fstream>
+
+// Maps a baud rate onto its termios constant, returns B0 for unsupported rates
+static speed_t toSpeed(int baudrate)
+{
+    switch(baudrate) {
+        case 9600 : return B9600;
+        case 19200 : return B19200;
+        case 38400 : return B38400;
+        case 57600 : return B57600;
+        case 115200 : return B115200;
+        case 230400 : return B230400;
+        case 460800 : return B460800;
+        case 500000 : return B500000;
+        case 576000 : return B576000;
+        case 921600 : return B921600;
+        case 1000000 : return B1000000;
+        case 1152000 : return B1152000;
+        case 1500000 : return B1500000;
+        case 2000000 : return B2000000;
+        case 2500000 : return B2500000;
+        case 3000000 : return B3000000;
+        case 3500000 : return B3500000;
+        case 4000000 : return B4000000;
+        default: return B0;
+    }
+}
+
+// Configures an open serial device, returns false and describes the failure in error
+static bool configureSerialPort(int fd, int baudrate, std::string& error)
+{
+    speed_t speed = toSpeed(baudrate);
+    if(speed == B0)
+    {
+        error = "unsupported baud rate " + std::to_string(baudrate);
+        return false;
+    }
+
+    termios config;
+    if(tcgetattr(fd, &config) != 0)
+    {
+        error = std::string("can not read the port settings: ") + strerror(errno);
+        return false;
+    }
+    cfmakeraw(&config);
+    cfsetispeed(&config, speed);
+    cfsetospeed(&config, speed);
+    // Reads return as soon as a single byte arrived instead of waiting for an inter byte timeout
+    config.c_cc[VMIN] = 1;
+    config.c_cc[VTIME] = 0;
+    if(tcsetattr(fd, TCSANOW, &config) != 0)
+    {
+        error = std::string("can not write the port settings: ") + strerror(errno);
+        return false;
+    }
+
+    // Not every driver supports the flag, e.g. pseudo terminals do not, so its failure is not fatal
+    serial_struct serial;
+    if(ioctl(fd, TIOCGSERIAL, &serial) == 0)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &serial);
+    }
+    return true;
+}
+
+// FTDI adapters buffer up to 16 ms before sending a USB packet, the timer is only exposed by sysfs
+static void setFtdiLatencyTimer(const std::string& device, int ftdi_latency_timer)
+{
+    char real_path[PATH_MAX];
+    if(ftdi_latency_timer <= 0 || !realpath(device.c_str(), real_path))
+    {
+        return;
+    }
+
+    std::string name(real_path);
+    name = name.substr(name.find_last_of('/') + 1);
+    std::ofstream latency_timer("/sys/bus/usb-serial/devices/" + name + "/latency_timer");
+    if(latency_timer)
+    {
+        latency_timer << ftdi_latency_timer;
+    }
+}
+
+bool configureLowLatencySerial(const std::string& device, int baudrate, int ftdi_latency_timer, std::string& error)
+{
+    // The termios settings belong to the device, so they apply to the file descriptor of the SDK as well
+    int fd = open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(fd < 0)
+    {
+        error = "can not open " + device + ": " + strerror(errno);
+        return false;
+    }
+
+    bool configured = configureSerialPort(fd, baudrate, error);
+    close(fd);
+    if(configured)
+    {
+        setFtdiLatencyTimer(device, ftdi_latency_timer);
+    }
+    return configured;
+}
+
+LinkBridge::~LinkBridge()
+{
+    stop();
+}
+
+void LinkBridge::setPacketHandler(PacketHandler handler)
+{
+    packet_handler_ = handler;
+}
+
+void LinkBridge::setReconnectInterval(double interval)
+{
+    reconnect_interval_ = interval;
+}
+
+void LinkBridge::setThreadScheduling(const ThreadScheduling& scheduling)
+{
+    scheduling_ = scheduling;
+}
+
+bool LinkBridge::openPseudoTerminal(std::string& error)
+{
+    master_fd_ = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master_fd_ < 0 || grantpt(master_fd_) != 0 || unlockpt(master_fd_) != 0)
+    {
+        error = std::string("can not create a pseudo terminal: ") + strerror(errno);
+        return false;
+    }
+    device_ = ptsname(master_fd_);
+
+    // Keep the slave open and raw, so no data is mangled before the SDK configured the port
+    slave_fd_ = open(device_.c_str(), O_RDWR | O_NOCTTY);
+    if(slave_fd_ < 0)
+    {
+        error = "can not open " + device_ + ": " + strerror(errno);
+        return false;
+    }
+    termios config;
+    tcgetattr(slave_fd_, &config);
+    cfmakeraw(&config);
+    tcsetattr(slave_fd_, TCSANOW, &config);
+
+    // A stalled SDK must not block the thread reading the link, data it does not take in time is dropped
+    if(fcntl(master_fd_, F_SETFL, fcntl(master_fd_, F_GETFL) | O_NONBLOCK) != 0)
+    {
+        error = std::string("can not configure the pseudo terminal: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool LinkBridge::startSerial(const std::string& device, int baudrate, int ftdi_latency_timer, std::string& error)
+{
+    if(!openPseudoTerminal(error))
+    {
+        stop();
+        return false;
+    }
+
+    serial_device_ = device;
+    baudrate_ = baudrate;
+    ftdi_latency_timer_ = ftdi_latency_timer;
+    if(!openSerialLink(error))
+    {
+        stop();
+        return false;
+    }
+
+    udp_ = false;
+    startForwarding();
+    return true;
+}
+
+bool LinkBridge::openSerialLink(std::string& error)
+{
+    int fd = open(serial_device_.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        error = "can not open " + serial_device_ + ": " + strerror(errno);
+        return false;
+    }
+    if(!configureSerialPort(fd, baudrate_, error))
+    {
+        close(fd);
+        return false;
+    }
+    setFtdiLatencyTimer(serial_device_, ftdi_latency_timer_);
+
+    link_fd_ = fd;
+    connected_ = true;
+    return true;
+}
+
+void LinkBridge::closeSerialLink(const std::string& reason)
+{
+    ROS_WARN("Closing %s, %s", serial_device_.c_str(), reason.c_str());
+    close(link_fd_);
+    link_fd_ = -1;
+    connected_ = false;
+    disconnects_++;
+    next_reconnect_ = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(reconnect_interval_));
+}
+
+bool LinkBridge::startUdp(int local_port, const std::string& remote_host, int remote_port, std::string& error)
+{
+    if(!openPseudoTerminal(error))
+    {
+        stop();
+        return false;
+    }
+
+    link_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    connected_ = link_fd_ >= 0;
+    sockaddr_in local_address{};
+    local_address.sin_family = AF_INET;
+    local_address.sin_addr.s_addr = htonl(INADDR_ANY);
+    local_address.sin_port = htons(local_port);
+    if(link_fd_ < 0 || bind(link_fd_, (sockaddr*) &local_address, sizeof(local_address)) != 0)
+    {
+        error = "can not bind UDP port " + std::to_string(local_port) + ": " + strerror(errno);
+        stop();
+        return false;
+    }
+
+    if(!remote_host.empty())
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* result = nullptr;
+        if(getaddrinfo(remote_host.c_str(), nullptr, &hints, &result) != 0 || !result)
+        {
+            error = "can not resolve " + remote_host;
+            stop();
+            return false;
+        }
+        remote_address_ = *(sockaddr_in*) result->ai_addr;
+        remote_address_.sin_port = htons(remote_port);
+        remote_known_ = true;
+        freeaddrinfo(result);
+    }
+
+    udp_ = true;
+    startForwarding();
+    return true;
+}
+
+void LinkBridge::startForwarding()
+{
+    if(packet_handler_)
+    {
+        // Large enough to take everything which arrives between two wakeups with a single read
+        framer_.reset(new MavlinkFramer(16384, [this](const MavlinkPacket& packet){ handlePacket(packet); }));
+    }
+
+    running_ = true;
+    thread_ = std::thread(&LinkBridge::forwardLoop, this);
+}
+
+void LinkBridge::stop()
+{
+    running_ = false;
+    if(thread_.joinable())
+    {
+        thread_.join();
+    }
+
+    for(int* fd : {&link_fd_, &slave_fd_, &master_fd_})
+    {
+        if(*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    connected_ = false;
+}
+
+void LinkBridge::requestReconnect()
+{
+    reconnect_requested_ = true;
+}
+
+bool LinkBridge::connected() const
+{
+    return connected_;
+}
+
+uint64_t LinkBridge::disconnects() const
+{
+    return disconnects_;
+}
+
+uint64_t LinkBridge::reconnects() const
+{
+    return reconnects_;
+}
+
+const std::string& LinkBridge::device() const
+{
+    return device_;
+}
+
+uint64_t LinkBridge::received() const
+{
+    return received_;
+}
+
+uint64_t LinkBridge::sent() const
+{
+    return sent_;
+}
+
+uint64_t LinkBridge::forward_failures() const
+{
+    return forward_failures_;
+}
+
+uint64_t LinkBridge::packets() const
+{
+    return framer_ ? framer_->packets() : 0;
+}
+
+uint64_t LinkBridge::consumed() const
+{
+    return consumed_;
+}
+
+uint64_t LinkBridge::bad_checksums() const
+{
+    return framer_ ? framer_->bad_checksums() : 0;
+}
+
+uint64_t LinkBridge::unknown_messages() const
+{
+    return framer_ ? framer_->unknown_messages() : 0;
+}
+
+void LinkBridge::handlePacket(const MavlinkPacket& packet)
+{
+    if(packet_handler_(packet))
+    {
+        consumed_++;
+        return;
+    }
+
+    // The pseudo terminal is non-blocking, a partial write drops the rest of the packet
+    if(write(master_fd_, packet.data, packet.length) != (ssize_t) packet.length)
+    {
+        forward_failures_++;
+        ROS_WARN_THROTTLE(1.0, "Can not forward a packet to the SDK");
+    }
+}
+
+void LinkBridge::sendToLink(const uint8_t* data, size_t length)
+{
+    // Commands sent while the serial device is closed are lost like on the wire
+    if(link_fd_ < 0)
+    {
+        return;
+    }
+
+    ssize_t written;
+    if(udp_)
+    {
+        // Nothing can be sent before the gimbal sent its first datagram
+        if(!remote_known_ && remote_address_.sin_port == 0)
+        {
+            return;
+        }
+        written = sendto(link_fd_, data, length, 0, (sockaddr*) &remote_address_, sizeof(remote_address_));
+    }
+    else
+    {
+        written = write(link_fd_, data, length);
+    }
+
+    if(written == (ssize_t) length)
+    {
+        sent_++;
+    }
+}
+
+void LinkBridge::forwardLoop()
+{
+    applyThreadScheduling(scheduling_, "link bridge thread");
+
+    // A datagram may carry several MAVLink packets, a read from the SDK everything it wrote since the last wakeup
+    uint8_t buffer[65536];
+    pollfd fds[2] = {{link_fd_, POLLIN, 0}, {master_fd_, POLLIN, 0}};
+
+    while(running_)
+    {
+        if(!udp_)
+        {
+            if(reconnect_requested_.exchange(false) && link_fd_ >= 0)
+            {
+                closeSerialLink("reconnect requested");
+            }
+            if(link_fd_ < 0 && std::chrono::steady_clock::now() >= next_reconnect_)
+            {
+                std::string error;
+                if(openSerialLink(error))
+                {
+                    reconnects_++;
+                    ROS_INFO("Reopened %s", serial_device_.c_str());
+                }
+                else
+                {
+                    next_reconnect_ = std::chrono::steady_clock::now() + std::chrono::duration_cast<
+                        std::chrono::steady_clock::duration>(std::chrono::duration<double>(reconnect_interval_));
+                    ROS_WARN_THROTTLE(5.0, "Can not reopen the link to the gimbal, %s", error.c_str());
+                }
+            }
+        }
+
+        // A closed serial device is skipped by poll, the SDK is still served meanwhile.
+        // Wake up regularly to notice a stop and to retry the serial device.
+        fds[0].fd = link_fd_;
+        int timeout = link_fd_ >= 0 ? 100 : std::min(100, std::max(1, (int) (reconnect_interval_ * 1000)));
+        if(poll(fds, 2, timeout) <= 0)
+        {
+            continue;
+        }
+
+        // Unplugging a USB adapter shows up as a hang up or an error
+        if(!udp_ && (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)))
+        {
+            closeSerialLink("the device failed");
+        }
+        else if(fds[0].revents & POLLIN)
+        {
+            ssize_t length;
+            if(udp_)
+            {
+                sockaddr_in sender;
+                socklen_t sender_length = sizeof(sender);
+                length = recvfrom(link_fd_, buffer, sizeof(buffer), 0, (sockaddr*) &sender, &sender_length);
+                if(length > 0)
+                {
+                    if(!remote_known_)
+                    {
+                        remote_address_ = sender;
+                    }
+                    if(framer_)
+                    {
+                        framer_->feed(buffer, length);
+                    }
+                    else if(write(master_fd_, buffer, length) != length)
+                    {
+                        forward_failures_++;
+                        ROS_WARN_THROTTLE(1.0, "Can not forward a datagram to the SDK");
+                    }
+                }
+            }
+            else if(framer_)
+            {
+                // The framer reads straight into its buffer, so a packet is never copied before it is handled
+                length = framer_->readFrom(link_fd_);
+            }
+            else
+            {
+                length = read(link_fd_, buffer, sizeof(buffer));
+                if(length > 0 && write(master_fd_, buffer, length) != length)
+                {
+                    forward_failures_++;
+                    ROS_WARN_THROTTLE(1.0, "Can not forward data to the SDK");
+                }
+            }
+
+            if(length > 0)
+            {
+                received_++;
+            }
+            else if(!udp_ && (length == 0 || (errno != EAGAIN && errno != EINTR)))
+            {
+                closeSerialLink(length == 0 ? std::string("the device was closed") : std::string(strerror(errno)));
+            }
+        }
+
+        if(fds[1].revents & POLLIN)
+        {
+            ssize_t length = read(master_fd_, buffer, sizeof(buffer));
+            if(length > 0)
+            {
+                sendToLink(buffer, length);
+            }
+        }
+    }
+}
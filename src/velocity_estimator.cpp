@@ -0,0 +1,85 @@
+#include <ros_gremsy/velocity_estimator.h>
+#include <cmath>
+
+// Gaps longer than this reset the estimation in s
+#define MAX_SAMPLE_GAP 1.0
+
+// Wraps an angle difference into [-pi, pi)
+static double wrapAngle(double angle)
+{
+    return angle - 2.0 * M_PI * std::floor((angle + M_PI) / (2.0 * M_PI));
+}
+
+void VelocityEstimator::configure(const Parameters& parameters)
+{
+    bool method_changed = parameters.method != parameters_.method;
+    parameters_ = parameters;
+    if(method_changed)
+    {
+        reset();
+    }
+}
+
+void VelocityEstimator::reset()
+{
+    samples_ = 0;
+}
+
+bool VelocityEstimator::update(const ros::Time& stamp, const double angles[3], double velocity[3])
+{
+    double dt = samples_ > 0 ? (stamp - last_stamp_).toSec() : 0.0;
+    if(samples_ > 0 && (dt <= 0.0 || dt > MAX_SAMPLE_GAP))
+    {
+        reset();
+    }
+    last_stamp_ = stamp;
+
+    if(samples_ == 0)
+    {
+        double r = parameters_.measurement_noise * parameters_.measurement_noise;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            angle_[axis] = angles[axis];
+            velocity_[axis] = 0.0;
+            // The velocity is unknown at the start, so the first samples are trusted
+            covariance_[axis][0] = r;
+            covariance_[axis][1] = 0.0;
+            covariance_[axis][2] = 1e3;
+        }
+        samples_++;
+        return false;
+    }
+    samples_++;
+
+    for(int axis = 0; axis < 3; axis++)
+    {
+        if(parameters_.method == FINITE_DIFFERENCE)
+        {
+            velocity_[axis] = wrapAngle(angles[axis] - angle_[axis]) / dt;
+            angle_[axis] = angles[axis];
+            continue;
+        }
+
+        // Prediction with constant velocity, the covariance is stored as (angle, cross, velocity)
+        double q = parameters_.process_noise;
+        double* p = covariance_[axis];
+        angle_[axis] = wrapAngle(angle_[axis] + velocity_[axis] * dt);
+        double p00 = p[0] + dt * (2.0 * p[1] + dt * p[2]) + q * dt * dt * dt / 3.0;
+        double p01 = p[1] + dt * p[2] + q * dt * dt / 2.0;
+        double p11 = p[2] + q * dt;
+
+        // Correction with the measured angle
+        double innovation = wrapAngle(angles[axis] - angle_[axis]);
+        double s = p00 + parameters_.measurement_noise * parameters_.measurement_noise;
+        double k0 = p00 / s;
+        double k1 = p01 / s;
+        angle_[axis] = wrapAngle(angle_[axis] + k0 * innovation);
+        velocity_[axis] += k1 * innovation;
+        p[0] = (1.0 - k0) * p00;
+        p[1] = (1.0 - k0) * p01;
+        p[2] = p11 - k1 * p01;
+    }
+
+    std::copy(velocity_, velocity_ + 3, velocity);
+    return true;
+}
@@ -0,0 +1,13 @@
+// Unit tests of the components of the GimbalNode which do not need a running ROS master or a gimbal.
+//
+// Run with: catkin_make run_tests_ros_gremsy
+#include <ros/ros.h>
+#include <gtest/gtest.h>
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    // The components only use ros::Time for arithmetic, which needs no node
+    ros::Time::init();
+    return RUN_ALL_TESTS();
+}
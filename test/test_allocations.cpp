@@ -0,0 +1,414 @@
+// Checks that the telemetry path of the GimbalNode does not touch the heap in the steady state.
+//
+// The global operator new is replaced to count the allocations, which is why this test runs as its own
+// executable. Only allocations of the test thread while it is passing samples are counted. The samples take
+// the path of the direct telemetry: framing, decoding into the snapshot, the sample queues, the message pools,
+// the conversions, the time synchronization, the IMU filter, the velocity estimation, the latency histograms
+// the fused state and the mount transforms. The publish calls are left out, roscpp allocates the buffers to
+// serialize a message for network subscribers.
+#include <ros_gremsy/ros_gremsy.h>
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#define GIMBAL_SYSTEM_ID 1
+#define GIMBAL_COMPONENT_ID 154
+// Samples passed before counting, so the pools, filters and fits reached their steady state
+#define WARMUP_SAMPLES 500
+#define MEASURED_SAMPLES 2000
+// Number of IMU periods a subscriber holds on to a message, less than the pool size
+#define HELD_PERIODS 4
+
+static thread_local bool count_allocations = false;
+static thread_local uint64_t allocations = 0;
+// Keeps the compiler from eliding an allocation whose memory is never used
+static void* volatile escaped;
+
+static void* allocate(size_t size, size_t alignment)
+{
+    if(count_allocations)
+    {
+        allocations++;
+    }
+    // aligned_alloc requires the size to be a multiple of the alignment
+    void* pointer = alignment > alignof(std::max_align_t) ?
+        aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : malloc(size);
+    if(!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+// Not inlined, so the compiler does not pair the free with the operator new of the caller
+__attribute__((noinline)) static void release(void* pointer)
+{
+    free(pointer);
+}
+
+void* operator new(size_t size)
+{
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept
+{
+    release(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    release(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    release(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    release(pointer);
+}
+
+namespace
+{
+
+// Counts the allocations of the current thread within its scope
+class AllocationCounter
+{
+public:
+    AllocationCounter()
+    {
+        allocations = 0;
+        count_allocations = true;
+    }
+
+    ~AllocationCounter()
+    {
+        count_allocations = false;
+    }
+
+    uint64_t count() const
+    {
+        return allocations;
+    }
+};
+
+// The telemetry path of the GimbalNode, with subscribers holding on to each published message for a while
+class TelemetryPath
+{
+public:
+    TelemetryPath() :
+        framer_(4 * MAVLINK_MAX_PACKET_LEN, [this](const MavlinkPacket& packet) { handlePacket(packet); }),
+        imu_queue_(64), mount_status_queue_(64), mount_orientation_queue_(64),
+        imu_pool_(8), encoder_pool_(8), encoder_velocity_pool_(8),
+        mount_orientation_global_pool_(8), mount_orientation_local_pool_(8), gimbal_state_pool_(8),
+        tf_pool_(8), mount_transforms_(2), imu_clock_(100), mount_orientation_clock_(100)
+    {
+        ImuFilter::Parameters imu_parameters;
+        imu_parameters.lowpass_cutoff = 20.0;
+        imu_parameters.bias_time_constant = 10.0;
+        imu_filter_.configure(imu_parameters);
+        VelocityEstimator::Parameters velocity_parameters;
+        velocity_parameters.method = VelocityEstimator::KALMAN;
+        velocity_estimator_.configure(velocity_parameters);
+        // The frame ids of the default config, the longer ones do not fit into the small string buffer
+        mount_transforms_[0].header.frame_id = "gimbal_base";
+        mount_transforms_[0].child_frame_id = "gimbal_camera";
+        mount_transforms_[1].header.frame_id = "gimbal_world";
+        mount_transforms_[1].child_frame_id = "gimbal_camera_global";
+
+        // Like the queues of the subscribers, the holders do not grow in the steady state
+        for(auto& held : held_)
+        {
+            held.reserve(16);
+        }
+    }
+
+    // Encodes the telemetry of the gimbal for one IMU period, the other streams run at a quarter of the rate
+    void encodeSample(size_t sample, std::vector<uint8_t>& stream)
+    {
+        mavlink_message_t message;
+        mavlink_raw_imu_t raw_imu = {};
+        raw_imu.time_usec = 1000000 + sample * 5000;
+        raw_imu.zacc = 1000;
+        raw_imu.zgyro = sample % 7;
+        mavlink_msg_raw_imu_encode(GIMBAL_SYSTEM_ID, GIMBAL_COMPONENT_ID, &message, &raw_imu);
+        append(message, stream);
+
+        if(sample % 4 == 0)
+        {
+            mavlink_mount_status_t mount_status = {};
+            mount_status.pointing_a = sample % 100;
+            mount_status.pointing_c = 2 * (sample % 100);
+            mavlink_msg_mount_status_encode(GIMBAL_SYSTEM_ID, GIMBAL_COMPONENT_ID, &message, &mount_status);
+            append(message, stream);
+
+            mavlink_mount_orientation_t mount_orientation = {};
+            mount_orientation.time_boot_ms = 1000 + sample * 5;
+            mount_orientation.pitch = 0.1f * (sample % 100);
+            mount_orientation.yaw = 1.0f;
+            mount_orientation.yaw_absolute = 2.0f;
+            mavlink_msg_mount_orientation_encode(GIMBAL_SYSTEM_ID, GIMBAL_COMPONENT_ID, &message, &mount_orientation);
+            append(message, stream);
+        }
+    }
+
+    // Passes the telemetry of one IMU period, like the reading and the publishing thread of the node
+    void process(const std::vector<uint8_t>& stream)
+    {
+        // Reads complete a packet at arbitrary positions
+        size_t split = stream.size() / 3;
+        framer_.feed(stream.data(), split);
+        framer_.feed(stream.data() + split, stream.size() - split);
+
+        // Published at the gimbals 200 Hz
+        stamp_ += 5000;
+        RawImuSample imu_sample;
+        while(imu_queue_.pop(imu_sample))
+        {
+            publishImu(imu_sample);
+        }
+        MountStatusSample mount_status_sample;
+        while(mount_status_queue_.pop(mount_status_sample))
+        {
+            publishEncoder(mount_status_sample);
+        }
+        MountOrientationSample mount_orientation_sample;
+        while(mount_orientation_queue_.pop(mount_orientation_sample))
+        {
+            publishMountOrientation(mount_orientation_sample);
+        }
+
+        // Subscribers release the messages of a few periods ago
+        held_period_ = (held_period_ + 1) % held_.size();
+        held_[held_period_].clear();
+    }
+
+    size_t packets() const
+    {
+        return framer_.packets();
+    }
+
+    uint64_t poolAllocations() const
+    {
+        return imu_pool_.allocations() + encoder_pool_.allocations() + encoder_velocity_pool_.allocations() +
+            mount_orientation_global_pool_.allocations() + mount_orientation_local_pool_.allocations() +
+            gimbal_state_pool_.allocations() + tf_pool_.allocations();
+    }
+
+private:
+    static void append(const mavlink_message_t& message, std::vector<uint8_t>& stream)
+    {
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+        stream.insert(stream.end(), buffer, buffer + length);
+    }
+
+    static ros::Time toROSTime(uint64_t stamp)
+    {
+        ros::Time time;
+        time.fromNSec(stamp * 1000);
+        return time;
+    }
+
+    void handlePacket(const MavlinkPacket& packet)
+    {
+        int64_t pickup_time;
+        switch(packet.message_id)
+        {
+            case MAVLINK_MSG_ID_RAW_IMU:
+                packet.decode(writer_snapshot_.raw_imu);
+                pickup_time = monotonicNanoseconds();
+                pickup_latency_.record(pickup_time - packet.receive_time);
+                writer_snapshot_.stamps.raw_imu = stamp_;
+                snapshot_.store(writer_snapshot_);
+                imu_queue_.push(RawImuSample{stamp_, writer_snapshot_.raw_imu, pickup_time});
+                break;
+            case MAVLINK_MSG_ID_MOUNT_STATUS:
+                packet.decode(writer_snapshot_.mount_status);
+                pickup_time = monotonicNanoseconds();
+                writer_snapshot_.stamps.mount_status = stamp_;
+                snapshot_.store(writer_snapshot_);
+                mount_status_queue_.push(MountStatusSample{stamp_, writer_snapshot_.mount_status, pickup_time});
+                break;
+            case MAVLINK_MSG_ID_MOUNT_ORIENTATION:
+                packet.decode(writer_snapshot_.mount_orientation);
+                pickup_time = monotonicNanoseconds();
+                writer_snapshot_.stamps.mount_orientation = stamp_;
+                snapshot_.store(writer_snapshot_);
+                mount_orientation_queue_.push(
+                    MountOrientationSample{stamp_, writer_snapshot_.mount_orientation, pickup_time});
+                break;
+        }
+    }
+
+    void publishImu(const RawImuSample& sample)
+    {
+        int64_t start_time = monotonicNanoseconds();
+        queue_latency_.record(start_time - sample.pickup_time);
+        sensor_msgs::ImuPtr imu = imu_pool_.acquire();
+        convertMavlink(sample.message, *imu);
+        imu->header.stamp = imu_clock_.update(sample.message.time_usec, toROSTime(sample.stamp));
+        imu_filter_.update(*imu);
+        gimbal_state_.imu = *imu;
+        gimbal_state_imu_ = true;
+        conversion_time_.record(monotonicNanoseconds() - start_time);
+        hold(imu);
+        publishState();
+    }
+
+    void publishEncoder(const MountStatusSample& sample)
+    {
+        geometry_msgs::Vector3StampedPtr encoder = encoder_pool_.acquire();
+        encoder->header.stamp = toROSTime(sample.stamp);
+        convertMavlink(sample.message, encoder->vector);
+
+        double angles[3] = {encoder->vector.x, encoder->vector.y, encoder->vector.z};
+        double velocity[3];
+        if(velocity_estimator_.update(encoder->header.stamp, angles, velocity))
+        {
+            geometry_msgs::Vector3StampedPtr encoder_velocity = encoder_velocity_pool_.acquire();
+            encoder_velocity->header.stamp = encoder->header.stamp;
+            encoder_velocity->vector.x = velocity[0];
+            encoder_velocity->vector.y = velocity[1];
+            encoder_velocity->vector.z = velocity[2];
+            gimbal_state_.encoder_velocity = encoder_velocity->vector;
+            hold(encoder_velocity);
+        }
+        gimbal_state_.encoder_stamp = encoder->header.stamp;
+        gimbal_state_.encoder = encoder->vector;
+        gimbal_state_encoder_ = true;
+        hold(encoder);
+        publishState();
+    }
+
+    void publishMountOrientation(const MountOrientationSample& sample)
+    {
+        geometry_msgs::QuaternionPtr global_yaw = mount_orientation_global_pool_.acquire();
+        convertMavlink<GlobalYaw>(sample.message, *global_yaw);
+        geometry_msgs::QuaternionPtr local_yaw = mount_orientation_local_pool_.acquire();
+        convertMavlink<LocalYaw>(sample.message, *local_yaw);
+        ros::Time stamp =
+            mount_orientation_clock_.update(sample.message.time_boot_ms * 1000ULL, toROSTime(sample.stamp));
+        gimbal_state_.mount_orientation_stamp = stamp;
+        gimbal_state_.mount_orientation_local_yaw = *local_yaw;
+        gimbal_state_.mount_orientation_global_yaw = *global_yaw;
+        hold(global_yaw);
+        hold(local_yaw);
+
+        // Broadcast like with publish_tf enabled
+        mount_transforms_[0].header.stamp = stamp;
+        mount_transforms_[0].transform.rotation = *local_yaw;
+        mount_transforms_[1].header.stamp = stamp;
+        mount_transforms_[1].transform.rotation = *global_yaw;
+        tf2_msgs::TFMessagePtr transforms = tf_pool_.acquire();
+        transforms->transforms = mount_transforms_;
+        hold(transforms);
+    }
+
+    // Publishes the fused state with every pair of a new encoder and IMU sample
+    void publishState()
+    {
+        if(!gimbal_state_imu_ || !gimbal_state_encoder_)
+        {
+            return;
+        }
+        ros_gremsy::GimbalStatePtr state = gimbal_state_pool_.acquire();
+        *state = gimbal_state_;
+        gimbal_state_imu_ = false;
+        gimbal_state_encoder_ = false;
+        hold(state);
+    }
+
+    // Keeps a published message referenced like a subscriber which has not processed it yet
+    void hold(const boost::shared_ptr<const void>& message)
+    {
+        held_[held_period_].push_back(message);
+    }
+
+    MavlinkFramer framer_;
+    uint64_t stamp_ = 1000000;
+    GimbalSnapshot writer_snapshot_{};
+    Seqlock<GimbalSnapshot> snapshot_;
+    SPSCQueue<RawImuSample> imu_queue_;
+    SPSCQueue<MountStatusSample> mount_status_queue_;
+    SPSCQueue<MountOrientationSample> mount_orientation_queue_;
+    MessagePool<sensor_msgs::Imu> imu_pool_;
+    MessagePool<geometry_msgs::Vector3Stamped> encoder_pool_;
+    MessagePool<geometry_msgs::Vector3Stamped> encoder_velocity_pool_;
+    MessagePool<geometry_msgs::Quaternion> mount_orientation_global_pool_;
+    MessagePool<geometry_msgs::Quaternion> mount_orientation_local_pool_;
+    MessagePool<ros_gremsy::GimbalState> gimbal_state_pool_;
+    MessagePool<tf2_msgs::TFMessage> tf_pool_;
+    std::vector<geometry_msgs::TransformStamped> mount_transforms_;
+    ClockSync imu_clock_;
+    ClockSync mount_orientation_clock_;
+    ImuFilter imu_filter_;
+    VelocityEstimator velocity_estimator_;
+    LatencyHistogram pickup_latency_;
+    LatencyHistogram queue_latency_;
+    LatencyHistogram conversion_time_;
+    ros_gremsy::GimbalState gimbal_state_;
+    bool gimbal_state_imu_ = false, gimbal_state_encoder_ = false;
+    // Messages held by the subscribers for each of the last periods
+    std::array<std::vector<boost::shared_ptr<const void>>, HELD_PERIODS> held_;
+    size_t held_period_ = 0;
+};
+
+}
+
+TEST(Allocations, CountsAllocations)
+{
+    // Make sure the counting itself works, otherwise the test below passes for nothing
+    AllocationCounter counter;
+    std::vector<int> vector(10);
+    escaped = vector.data();
+    EXPECT_EQ(1u, counter.count());
+}
+
+TEST(Allocations, TelemetryPathDoesNotAllocate)
+{
+    TelemetryPath path;
+
+    // The frames are encoded up front, the gimbal side is not part of the node
+    std::vector<std::vector<uint8_t>> streams(WARMUP_SAMPLES + MEASURED_SAMPLES);
+    for(size_t i = 0; i < streams.size(); i++)
+    {
+        path.encodeSample(i, streams[i]);
+    }
+
+    for(size_t i = 0; i < WARMUP_SAMPLES; i++)
+    {
+        path.process(streams[i]);
+    }
+
+    size_t packets = path.packets();
+    uint64_t measured_allocations;
+    {
+        AllocationCounter counter;
+        for(size_t i = WARMUP_SAMPLES; i < streams.size(); i++)
+        {
+            path.process(streams[i]);
+        }
+        measured_allocations = counter.count();
+    }
+
+    EXPECT_EQ(MEASURED_SAMPLES * 3u / 2, path.packets() - packets);
+    EXPECT_EQ(0u, path.poolAllocations());
+    EXPECT_EQ(0u, measured_allocations);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    ros::Time::init();
+    return RUN_ALL_TESTS();
+}
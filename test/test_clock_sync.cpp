@@ -0,0 +1,112 @@
+#include <ros_gremsy/clock_sync.h>
+#include <gtest/gtest.h>
+
+// Accuracy of the mapped time stamps in s
+#define TOLERANCE 1e-6
+
+namespace
+{
+
+const ros::Time receive_origin(1000.0);
+
+// Receive time of a device time stamp for a link with the given offset and drift
+ros::Time receiveTime(uint64_t device_usec, double offset, double drift)
+{
+    return receive_origin + ros::Duration(offset + drift * device_usec * 1e-6);
+}
+
+}
+
+TEST(ClockSync, FirstSampleKeepsReceiveTime)
+{
+    ClockSync clock_sync(10);
+    ros::Time receive_time = receiveTime(5000000, 0.01, 1.0);
+    EXPECT_EQ(receive_time, clock_sync.update(5000000, receive_time));
+}
+
+TEST(ClockSync, FollowsOffset)
+{
+    ClockSync clock_sync(10);
+    for(uint64_t device_usec = 0; device_usec < 1000000; device_usec += 10000)
+    {
+        ros::Time receive_time = receiveTime(device_usec, 0.02, 1.0);
+        EXPECT_NEAR(receive_time.toSec(), clock_sync.update(device_usec, receive_time).toSec(), TOLERANCE);
+    }
+}
+
+TEST(ClockSync, EstimatesDrift)
+{
+    ClockSync clock_sync(50);
+    for(uint64_t device_usec = 0; device_usec < 1000000; device_usec += 10000)
+    {
+        clock_sync.update(device_usec, receiveTime(device_usec, 0.02, 1.001));
+    }
+    // The fit extrapolates beyond the last sample
+    EXPECT_NEAR(receiveTime(2000000, 0.02, 1.001).toSec(), clock_sync.toROSTime(2000000).toSec(), TOLERANCE);
+}
+
+TEST(ClockSync, AveragesJitter)
+{
+    ClockSync clock_sync(100);
+    ros::Time mapped;
+    for(uint64_t i = 0; i < 200; i++)
+    {
+        // The receive time scatters around the true time by the scheduling of the reading thread
+        uint64_t device_usec = i * 5000;
+        double jitter = i % 2 ? 1e-3 : -1e-3;
+        mapped = clock_sync.update(device_usec, receiveTime(device_usec, 0.0, 1.0) + ros::Duration(jitter));
+    }
+    EXPECT_NEAR(receiveTime(199 * 5000, 0.0, 1.0).toSec(), mapped.toSec(), 1e-4);
+}
+
+TEST(ClockSync, ResetsOnBackwardsJump)
+{
+    ClockSync clock_sync(10);
+    for(uint64_t device_usec = 1000000; device_usec < 2000000; device_usec += 100000)
+    {
+        clock_sync.update(device_usec, receiveTime(device_usec, 0.0, 1.0));
+    }
+
+    // The gimbal rebooted, the new device clock starts with the next sample
+    ros::Time receive_time = receiveTime(3000000, 0.0, 1.0);
+    EXPECT_EQ(receive_time, clock_sync.update(100, receive_time));
+    ros::Time next_receive_time = receive_time + ros::Duration(0.1);
+    EXPECT_NEAR(next_receive_time.toSec(), clock_sync.update(100100, next_receive_time).toSec(), TOLERANCE);
+}
+
+TEST(ClockSync, KeepsNominalDriftForEqualStamps)
+{
+    ClockSync clock_sync(10);
+    clock_sync.update(1000, receiveTime(1000, 0.0, 1.0));
+    ros::Time mapped = clock_sync.update(1000, receiveTime(1000, 0.0, 1.0) + ros::Duration(0.002));
+    // Both samples map to their mean
+    EXPECT_NEAR(receiveTime(1000, 0.001, 1.0).toSec(), mapped.toSec(), TOLERANCE);
+    EXPECT_NEAR(receiveTime(1001000, 0.001, 1.0).toSec(), clock_sync.toROSTime(1001000).toSec(), TOLERANCE);
+}
+
+TEST(ClockSync, WindowForgetsOldSamples)
+{
+    ClockSync clock_sync(10);
+    clock_sync.setWindowSize(2);
+    uint64_t device_usec = 0;
+    for(; device_usec < 100000; device_usec += 10000)
+    {
+        clock_sync.update(device_usec, receiveTime(device_usec, 0.0, 1.0));
+    }
+
+    // With two samples in the window the new offset is taken over after two samples
+    clock_sync.update(device_usec, receiveTime(device_usec, 0.5, 1.0));
+    device_usec += 10000;
+    ros::Time receive_time = receiveTime(device_usec, 0.5, 1.0);
+    EXPECT_NEAR(receive_time.toSec(), clock_sync.update(device_usec, receive_time).toSec(), TOLERANCE);
+}
+
+TEST(ClockSync, ResetDropsSamples)
+{
+    ClockSync clock_sync(10);
+    clock_sync.update(0, receiveTime(0, 0.0, 1.0));
+    clock_sync.update(10000, receiveTime(10000, 0.0, 1.0));
+    clock_sync.reset();
+    ros::Time receive_time = receiveTime(20000, 0.3, 1.0);
+    EXPECT_EQ(receive_time, clock_sync.update(20000, receive_time));
+}
@@ -0,0 +1,201 @@
+#include <ros_gremsy/imu_filter.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+#define STANDARD_GRAVITY 9.80665
+#define SAMPLE_PERIOD 0.005
+
+namespace
+{
+
+sensor_msgs::Imu imu(size_t sample, double ax, double ay, double az, double gx, double gy, double gz)
+{
+    sensor_msgs::Imu imu;
+    imu.header.stamp = ros::Time(100.0 + sample * SAMPLE_PERIOD);
+    imu.linear_acceleration.x = ax;
+    imu.linear_acceleration.y = ay;
+    imu.linear_acceleration.z = az;
+    imu.angular_velocity.x = gx;
+    imu.angular_velocity.y = gy;
+    imu.angular_velocity.z = gz;
+    return imu;
+}
+
+// Sample of a gimbal at rest with the given gyro bias
+sensor_msgs::Imu resting(size_t sample, double bias)
+{
+    return imu(sample, 0.0, 0.0, STANDARD_GRAVITY, bias, -bias, 0.5 * bias);
+}
+
+}
+
+TEST(ImuFilter, ScalesSamples)
+{
+    ImuFilter filter;
+    ImuFilter::Parameters parameters;
+    parameters.accel_scale = 2.0;
+    parameters.gyro_scale = 0.5;
+    filter.configure(parameters);
+
+    sensor_msgs::Imu message = imu(0, 1.0, 2.0, 3.0, 0.2, 0.4, 0.6);
+    filter.update(message);
+    EXPECT_DOUBLE_EQ(2.0, message.linear_acceleration.x);
+    EXPECT_DOUBLE_EQ(4.0, message.linear_acceleration.y);
+    EXPECT_DOUBLE_EQ(6.0, message.linear_acceleration.z);
+    EXPECT_DOUBLE_EQ(0.1, message.angular_velocity.x);
+    EXPECT_DOUBLE_EQ(0.2, message.angular_velocity.y);
+    EXPECT_DOUBLE_EQ(0.3, message.angular_velocity.z);
+}
+
+TEST(ImuFilter, SetsCovariances)
+{
+    ImuFilter filter;
+    ImuFilter::Parameters parameters;
+    parameters.accel_noise = 0.1;
+    parameters.gyro_noise = 0.01;
+    parameters.orientation_noise = 0.02;
+    filter.configure(parameters);
+
+    sensor_msgs::Imu message = resting(0, 0.0);
+    filter.update(message);
+    for(int axis = 0; axis < 3; axis++)
+    {
+        EXPECT_DOUBLE_EQ(0.01, message.linear_acceleration_covariance[axis * 4]);
+        EXPECT_DOUBLE_EQ(1e-4, message.angular_velocity_covariance[axis * 4]);
+    }
+    EXPECT_DOUBLE_EQ(4e-4, message.orientation_covariance[0]);
+    EXPECT_DOUBLE_EQ(4e-4, message.orientation_covariance[4]);
+    // The yaw is not observable
+    EXPECT_DOUBLE_EQ(M_PI * M_PI, message.orientation_covariance[8]);
+    EXPECT_DOUBLE_EQ(0.0, message.orientation_covariance[1]);
+}
+
+TEST(ImuFilter, StartsFromMeasuredTilt)
+{
+    ImuFilter filter;
+    filter.configure(ImuFilter::Parameters());
+    const double roll = 0.3;
+    sensor_msgs::Imu message = imu(0, 0.0, STANDARD_GRAVITY * std::sin(roll), STANDARD_GRAVITY * std::cos(roll), 0.0, 0.0, 0.0);
+    filter.update(message);
+    EXPECT_NEAR(std::sin(0.5 * roll), message.orientation.x, 1e-9);
+    EXPECT_NEAR(0.0, message.orientation.y, 1e-9);
+    EXPECT_NEAR(0.0, message.orientation.z, 1e-9);
+    EXPECT_NEAR(std::cos(0.5 * roll), message.orientation.w, 1e-9);
+}
+
+TEST(ImuFilter, IntegratesYawRate)
+{
+    ImuFilter filter;
+    filter.configure(ImuFilter::Parameters());
+    sensor_msgs::Imu message;
+    // A quarter turn around the z axis within one second
+    for(size_t i = 0; i <= 200; i++)
+    {
+        message = imu(i, 0.0, 0.0, STANDARD_GRAVITY, 0.0, 0.0, 0.5 * M_PI);
+        filter.update(message);
+    }
+    EXPECT_NEAR(std::sin(0.25 * M_PI), message.orientation.z, 1e-6);
+    EXPECT_NEAR(std::cos(0.25 * M_PI), message.orientation.w, 1e-6);
+}
+
+TEST(ImuFilter, EstimatesGyroBiasAtRest)
+{
+    ImuFilter filter;
+    ImuFilter::Parameters parameters;
+    parameters.bias_time_constant = 0.1;
+    filter.configure(parameters);
+
+    sensor_msgs::Imu message;
+    for(size_t i = 0; i < 400; i++)
+    {
+        message = resting(i, 0.01);
+        filter.update(message);
+    }
+    EXPECT_NEAR(0.01, filter.gyroBias()[0], 1e-6);
+    EXPECT_NEAR(-0.01, filter.gyroBias()[1], 1e-6);
+    EXPECT_NEAR(0.005, filter.gyroBias()[2], 1e-6);
+    // The published rates are corrected by the bias
+    EXPECT_NEAR(0.0, message.angular_velocity.x, 1e-6);
+    EXPECT_NEAR(0.0, message.angular_velocity.y, 1e-6);
+}
+
+TEST(ImuFilter, KeepsBiasWhileMoving)
+{
+    ImuFilter filter;
+    ImuFilter::Parameters parameters;
+    parameters.bias_time_constant = 0.1;
+    filter.configure(parameters);
+
+    for(size_t i = 0; i < 100; i++)
+    {
+        sensor_msgs::Imu message = imu(i, 0.0, 0.0, STANDARD_GRAVITY, 0.0, 0.0, 1.0);
+        filter.update(message);
+    }
+    EXPECT_EQ(0.0, filter.gyroBias()[2]);
+}
+
+TEST(ImuFilter, LowPassAttenuatesVibration)
+{
+    ImuFilter filter;
+    ImuFilter::Parameters parameters;
+    parameters.lowpass_cutoff = 5.0;
+    filter.configure(parameters);
+
+    // Vibration at half the sample rate around a constant yaw rate
+    double peak = 0.0;
+    for(size_t i = 0; i < 400; i++)
+    {
+        double vibration = i % 2 ? 0.5 : -0.5;
+        sensor_msgs::Imu message = imu(i, 0.0, 0.0, STANDARD_GRAVITY, 0.0, 0.0, 0.2 + vibration);
+        filter.update(message);
+        if(i >= 300)
+        {
+            peak = std::max(peak, std::abs(message.angular_velocity.z - 0.2));
+        }
+    }
+    EXPECT_LT(peak, 0.01);
+}
+
+TEST(ImuFilter, NotchRemovesFrequency)
+{
+    ImuFilter filter;
+    ImuFilter::Parameters parameters;
+    parameters.notch_frequency = 50.0;
+    parameters.notch_bandwidth = 10.0;
+    filter.configure(parameters);
+
+    double peak = 0.0;
+    for(size_t i = 0; i < 400; i++)
+    {
+        double vibration = 0.5 * std::sin(2.0 * M_PI * 50.0 * i * SAMPLE_PERIOD);
+        sensor_msgs::Imu message = imu(i, 0.0, 0.0, STANDARD_GRAVITY, vibration, 0.0, 0.0);
+        filter.update(message);
+        if(i >= 300)
+        {
+            peak = std::max(peak, std::abs(message.angular_velocity.x));
+        }
+    }
+    EXPECT_LT(peak, 0.01);
+}
+
+TEST(ImuFilter, ResetsAfterGap)
+{
+    ImuFilter filter;
+    ImuFilter::Parameters parameters;
+    parameters.bias_time_constant = 0.1;
+    filter.configure(parameters);
+    for(size_t i = 0; i < 100; i++)
+    {
+        sensor_msgs::Imu message = resting(i, 0.01);
+        filter.update(message);
+    }
+    ASSERT_GT(filter.gyroBias()[0], 0.0);
+
+    // After a gap the orientation starts from the measured tilt again
+    const double pitch = -0.2;
+    sensor_msgs::Imu message = imu(1000, -STANDARD_GRAVITY * std::sin(pitch), 0.0, STANDARD_GRAVITY * std::cos(pitch), 0.0, 0.0, 0.0);
+    filter.update(message);
+    EXPECT_EQ(0.0, filter.gyroBias()[0]);
+    EXPECT_NEAR(std::sin(0.5 * pitch), message.orientation.y, 1e-9);
+    EXPECT_NEAR(std::cos(0.5 * pitch), message.orientation.w, 1e-9);
+}
@@ -0,0 +1,83 @@
+#include <ros_gremsy/latency_histogram.h>
+#include <gtest/gtest.h>
+
+// Width of a bucket, percentiles are reported as the upper bound of their bucket
+#define BUCKET_RATIO 1.1893
+
+TEST(LatencyHistogram, EmptySummary)
+{
+    LatencyHistogram histogram;
+    LatencyHistogram::Summary summary = histogram.collect();
+    EXPECT_EQ(0u, summary.count);
+    EXPECT_EQ(0.0, summary.mean);
+    EXPECT_EQ(0.0, summary.p50);
+    EXPECT_EQ(0.0, summary.p99);
+    EXPECT_EQ(0.0, summary.max);
+}
+
+TEST(LatencyHistogram, SummarizesSamples)
+{
+    LatencyHistogram histogram;
+    // 1 to 100 us
+    for(int i = 1; i <= 100; i++)
+    {
+        histogram.record(i * 1000);
+    }
+    LatencyHistogram::Summary summary = histogram.collect();
+    EXPECT_EQ(100u, summary.count);
+    EXPECT_DOUBLE_EQ(50.5e-6, summary.mean);
+    EXPECT_DOUBLE_EQ(100e-6, summary.max);
+
+    // The percentiles are exact up to the width of a bucket
+    EXPECT_GE(summary.p50, 50e-6);
+    EXPECT_LE(summary.p50, 50e-6 * BUCKET_RATIO);
+    EXPECT_GE(summary.p90, 90e-6);
+    EXPECT_LE(summary.p90, 90e-6 * BUCKET_RATIO);
+    EXPECT_GE(summary.p99, 99e-6);
+    EXPECT_LE(summary.p99, summary.max);
+    EXPECT_LE(summary.p50, summary.p90);
+    EXPECT_LE(summary.p90, summary.p99);
+}
+
+TEST(LatencyHistogram, CapsPercentilesAtMaximum)
+{
+    LatencyHistogram histogram;
+    histogram.record(1000);
+    LatencyHistogram::Summary summary = histogram.collect();
+    EXPECT_DOUBLE_EQ(1e-6, summary.p50);
+    EXPECT_DOUBLE_EQ(1e-6, summary.p99);
+    EXPECT_DOUBLE_EQ(1e-6, summary.max);
+}
+
+TEST(LatencyHistogram, ClampsNegativeSamples)
+{
+    LatencyHistogram histogram;
+    histogram.record(-1000);
+    histogram.record(0);
+    LatencyHistogram::Summary summary = histogram.collect();
+    EXPECT_EQ(2u, summary.count);
+    EXPECT_EQ(0.0, summary.mean);
+    EXPECT_EQ(0.0, summary.max);
+}
+
+TEST(LatencyHistogram, RecordsHugeSamplesInLastBucket)
+{
+    LatencyHistogram histogram;
+    histogram.record(INT64_MAX);
+    LatencyHistogram::Summary summary = histogram.collect();
+    EXPECT_EQ(1u, summary.count);
+    EXPECT_GT(summary.p50, 0.0);
+    EXPECT_LE(summary.p50, summary.max);
+}
+
+TEST(LatencyHistogram, CollectStartsNewPeriod)
+{
+    LatencyHistogram histogram;
+    histogram.record(5000);
+    histogram.collect();
+    histogram.record(1000);
+    LatencyHistogram::Summary summary = histogram.collect();
+    EXPECT_EQ(1u, summary.count);
+    EXPECT_DOUBLE_EQ(1e-6, summary.max);
+    EXPECT_EQ(0u, histogram.collect().count);
+}
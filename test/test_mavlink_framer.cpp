@@ -0,0 +1,209 @@
+#include <ros_gremsy/mavlink_framer.h>
+#include <gtest/gtest.h>
+#include <vector>
+#include "serial_port.h"
+
+#define GIMBAL_SYSTEM_ID 1
+#define GIMBAL_COMPONENT_ID 154
+
+namespace
+{
+
+// Encodes a RAW_IMU message into a frame, channels configured for MAVLink 1 produce MAVLink 1 frames
+std::vector<uint8_t> rawImuFrame(const mavlink_raw_imu_t& raw_imu, uint8_t channel = MAVLINK_COMM_0)
+{
+    mavlink_message_t message;
+    mavlink_msg_raw_imu_encode_chan(GIMBAL_SYSTEM_ID, GIMBAL_COMPONENT_ID, channel, &message, &raw_imu);
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+    return std::vector<uint8_t>(buffer, buffer + length);
+}
+
+mavlink_raw_imu_t rawImu(uint64_t time_usec)
+{
+    mavlink_raw_imu_t raw_imu = {};
+    raw_imu.time_usec = time_usec;
+    raw_imu.xacc = 1;
+    raw_imu.yacc = -1000;
+    raw_imu.zacc = 1000;
+    raw_imu.xgyro = 4;
+    raw_imu.ygyro = -5;
+    raw_imu.zgyro = 6;
+    return raw_imu;
+}
+
+// Collects the framed packets, their payload is only valid within the handler
+class MavlinkFramerTest : public testing::Test
+{
+protected:
+    MavlinkFramerTest() : framer_(512, [this](const MavlinkPacket& packet) { handle(packet); })
+    {
+        // Every test encodes the same frames, independent of the tests before
+        mavlink_get_channel_status(MAVLINK_COMM_0)->current_tx_seq = 0;
+        mavlink_get_channel_status(MAVLINK_COMM_1)->current_tx_seq = 0;
+    }
+
+    void handle(const MavlinkPacket& packet)
+    {
+        packets_.push_back(packet);
+        mavlink_raw_imu_t raw_imu;
+        packet.decode(raw_imu);
+        raw_imus_.push_back(raw_imu);
+    }
+
+    void feed(const std::vector<uint8_t>& data)
+    {
+        framer_.feed(data.data(), data.size());
+    }
+
+    MavlinkFramer framer_;
+    std::vector<MavlinkPacket> packets_;
+    std::vector<mavlink_raw_imu_t> raw_imus_;
+};
+
+}
+
+TEST_F(MavlinkFramerTest, FramesPacket)
+{
+    feed(rawImuFrame(rawImu(1234)));
+
+    ASSERT_EQ(1u, packets_.size());
+    EXPECT_EQ((uint32_t) MAVLINK_MSG_ID_RAW_IMU, packets_[0].message_id);
+    EXPECT_EQ(GIMBAL_SYSTEM_ID, packets_[0].system_id);
+    EXPECT_EQ(GIMBAL_COMPONENT_ID, packets_[0].component_id);
+    EXPECT_GT(packets_[0].receive_time, 0);
+    EXPECT_EQ(1234u, raw_imus_[0].time_usec);
+    EXPECT_EQ(-1000, raw_imus_[0].yacc);
+    EXPECT_EQ(1000, raw_imus_[0].zacc);
+    EXPECT_EQ(6, raw_imus_[0].zgyro);
+    EXPECT_EQ(1u, framer_.packets());
+    EXPECT_EQ(0u, framer_.skipped_bytes());
+    EXPECT_EQ(0u, framer_.bad_checksums());
+}
+
+TEST_F(MavlinkFramerTest, RestoresTruncatedPayload)
+{
+    // MAVLink 2 drops the trailing zeros of the payload, the decoded message is zero filled
+    mavlink_raw_imu_t raw_imu = rawImu(1);
+    raw_imu.zgyro = 0;
+    std::vector<uint8_t> frame = rawImuFrame(raw_imu);
+    EXPECT_LT(frame.size(), MAVLINK_MSG_ID_RAW_IMU_LEN + 12u);
+
+    feed(frame);
+    ASSERT_EQ(1u, raw_imus_.size());
+    EXPECT_EQ(0, raw_imus_[0].zgyro);
+    EXPECT_EQ(-5, raw_imus_[0].ygyro);
+}
+
+TEST_F(MavlinkFramerTest, FramesByteStream)
+{
+    // Packets split over any number of reads are framed once they are complete
+    std::vector<uint8_t> stream;
+    for(uint64_t i = 1; i <= 3; i++)
+    {
+        std::vector<uint8_t> frame = rawImuFrame(rawImu(i));
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    for(uint8_t byte : stream)
+    {
+        framer_.feed(&byte, 1);
+    }
+
+    ASSERT_EQ(3u, raw_imus_.size());
+    for(uint64_t i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(i + 1, raw_imus_[i].time_usec);
+    }
+    // Consecutive frames carry consecutive sequence numbers
+    EXPECT_EQ((uint8_t) (packets_[0].sequence + 1), packets_[1].sequence);
+}
+
+TEST_F(MavlinkFramerTest, FramesMavlink1)
+{
+    mavlink_get_channel_status(MAVLINK_COMM_1)->flags |= MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+    std::vector<uint8_t> frame = rawImuFrame(rawImu(42), MAVLINK_COMM_1);
+    mavlink_get_channel_status(MAVLINK_COMM_1)->flags &= ~MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+    ASSERT_EQ(MAVLINK_STX_MAVLINK1, frame[0]);
+
+    feed(frame);
+    ASSERT_EQ(1u, raw_imus_.size());
+    EXPECT_EQ(42u, raw_imus_[0].time_usec);
+    EXPECT_EQ(GIMBAL_COMPONENT_ID, packets_[0].component_id);
+}
+
+TEST_F(MavlinkFramerTest, SkipsBytesBetweenPackets)
+{
+    std::vector<uint8_t> stream = {0x00, 0x11, 0x22};
+    std::vector<uint8_t> frame = rawImuFrame(rawImu(7));
+    stream.insert(stream.end(), frame.begin(), frame.end());
+    stream.push_back(0x33);
+    feed(stream);
+
+    ASSERT_EQ(1u, raw_imus_.size());
+    EXPECT_EQ(7u, raw_imus_[0].time_usec);
+    EXPECT_EQ(4u, framer_.skipped_bytes());
+}
+
+TEST_F(MavlinkFramerTest, DropsPacketWithBadChecksum)
+{
+    std::vector<uint8_t> corrupted = rawImuFrame(rawImu(1));
+    corrupted[12] ^= 0x01;
+    std::vector<uint8_t> frame = rawImuFrame(rawImu(2));
+    corrupted.insert(corrupted.end(), frame.begin(), frame.end());
+    feed(corrupted);
+
+    // The framer resynchronizes on the following packet
+    ASSERT_EQ(1u, raw_imus_.size());
+    EXPECT_EQ(2u, raw_imus_[0].time_usec);
+    EXPECT_EQ(1u, framer_.bad_checksums());
+}
+
+TEST_F(MavlinkFramerTest, ResyncsOnUnknownMessage)
+{
+    // A start byte with an unknown message id must not swallow the packet behind it
+    std::vector<uint8_t> stream = rawImuFrame(rawImu(1));
+    stream.resize(10);
+    stream[7] = 0xff;
+    stream[8] = 0xff;
+    stream[9] = 0xff;
+    std::vector<uint8_t> frame = rawImuFrame(rawImu(2));
+    stream.insert(stream.end(), frame.begin(), frame.end());
+    feed(stream);
+
+    ASSERT_EQ(1u, raw_imus_.size());
+    EXPECT_EQ(2u, raw_imus_[0].time_usec);
+    EXPECT_EQ(1u, framer_.unknown_messages());
+    EXPECT_EQ(10u, framer_.skipped_bytes());
+}
+
+TEST_F(MavlinkFramerTest, ResyncsOnUnknownFlags)
+{
+    // Only signing is known, a packet with another flag can not be framed
+    std::vector<uint8_t> stream = rawImuFrame(rawImu(1));
+    stream[2] = 0x80;
+    stream.resize(6);
+    std::vector<uint8_t> frame = rawImuFrame(rawImu(2));
+    stream.insert(stream.end(), frame.begin(), frame.end());
+    feed(stream);
+
+    ASSERT_EQ(1u, raw_imus_.size());
+    EXPECT_EQ(2u, raw_imus_[0].time_usec);
+    EXPECT_EQ(6u, framer_.skipped_bytes());
+}
+
+TEST_F(MavlinkFramerTest, FeedsMoreThanBuffer)
+{
+    // The buffer is drained while feeding, so a large chunk is framed completely
+    std::vector<uint8_t> stream;
+    for(uint64_t i = 1; i <= 100; i++)
+    {
+        std::vector<uint8_t> frame = rawImuFrame(rawImu(i));
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    ASSERT_GT(stream.size(), 512u);
+    feed(stream);
+
+    ASSERT_EQ(100u, raw_imus_.size());
+    EXPECT_EQ(100u, raw_imus_.back().time_usec);
+    EXPECT_EQ(0u, framer_.skipped_bytes());
+}
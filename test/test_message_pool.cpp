@@ -0,0 +1,85 @@
+#include <ros_gremsy/message_pool.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+
+struct Message
+{
+    int value = 0;
+    std::vector<int> data;
+};
+
+}
+
+TEST(MessagePool, RecyclesReleasedMessages)
+{
+    MessagePool<Message> pool(2);
+    Message* first;
+    {
+        boost::shared_ptr<Message> message = pool.acquire();
+        first = message.get();
+        message->value = 42;
+    }
+
+    // The pool hands out the messages in turn, so the released one comes back after the other
+    boost::shared_ptr<Message> second = pool.acquire();
+    EXPECT_NE(first, second.get());
+    boost::shared_ptr<Message> third = pool.acquire();
+    EXPECT_EQ(first, third.get());
+    // Recycled messages keep their content
+    EXPECT_EQ(42, third->value);
+    EXPECT_EQ(0u, pool.allocations());
+}
+
+TEST(MessagePool, SkipsMessagesStillHeld)
+{
+    MessagePool<Message> pool(3);
+    boost::shared_ptr<Message> held = pool.acquire();
+    for(int i = 0; i < 10; i++)
+    {
+        boost::shared_ptr<Message> message = pool.acquire();
+        EXPECT_NE(held.get(), message.get());
+    }
+    EXPECT_EQ(0u, pool.allocations());
+}
+
+TEST(MessagePool, AllocatesWhenExhausted)
+{
+    MessagePool<Message> pool(2);
+    boost::shared_ptr<Message> a = pool.acquire();
+    boost::shared_ptr<Message> b = pool.acquire();
+    boost::shared_ptr<Message> c = pool.acquire();
+    EXPECT_NE(a.get(), c.get());
+    EXPECT_NE(b.get(), c.get());
+    EXPECT_EQ(1u, pool.allocations());
+
+    // Allocated messages are not added to the pool
+    c.reset();
+    boost::shared_ptr<Message> d = pool.acquire();
+    EXPECT_EQ(2u, pool.allocations());
+}
+
+TEST(MessagePool, KeepsCapacityOfRecycledMessages)
+{
+    MessagePool<Message> pool(1);
+    {
+        boost::shared_ptr<Message> message = pool.acquire();
+        message->data.reserve(100);
+    }
+    boost::shared_ptr<Message> message = pool.acquire();
+    EXPECT_GE(message->data.capacity(), 100u);
+}
+
+TEST(MessagePool, ResizeReplacesMessages)
+{
+    MessagePool<Message> pool(1);
+    boost::shared_ptr<Message> held = pool.acquire();
+    pool.resize(2);
+    boost::shared_ptr<Message> a = pool.acquire();
+    boost::shared_ptr<Message> b = pool.acquire();
+    EXPECT_NE(held.get(), a.get());
+    EXPECT_NE(held.get(), b.get());
+    EXPECT_EQ(0u, pool.allocations());
+}
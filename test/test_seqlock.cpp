@@ -0,0 +1,76 @@
+#include <ros_gremsy/seqlock.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+namespace
+{
+
+struct Value
+{
+    uint64_t a;
+    uint64_t b;
+    uint64_t c;
+};
+
+}
+
+TEST(Seqlock, StartsZeroed)
+{
+    Seqlock<Value> seqlock;
+    Value value = seqlock.load();
+    EXPECT_EQ(0u, value.a);
+    EXPECT_EQ(0u, value.b);
+    EXPECT_EQ(0u, value.c);
+    EXPECT_EQ(0u, seqlock.version());
+}
+
+TEST(Seqlock, LoadsStoredValue)
+{
+    Seqlock<Value> seqlock;
+    seqlock.store(Value{1, 2, 3});
+    Value value = seqlock.load();
+    EXPECT_EQ(1u, value.a);
+    EXPECT_EQ(2u, value.b);
+    EXPECT_EQ(3u, value.c);
+}
+
+TEST(Seqlock, CountsStores)
+{
+    Seqlock<Value> seqlock;
+    for(uint64_t i = 1; i <= 5; i++)
+    {
+        seqlock.store(Value{i, i, i});
+        EXPECT_EQ(i, seqlock.version());
+    }
+}
+
+TEST(Seqlock, NeverLoadsTornValue)
+{
+    Seqlock<Value> seqlock;
+    std::atomic<bool> running{true};
+
+    // All fields of a stored value are equal, a torn read would mix two of them
+    std::thread writer([&seqlock, &running]()
+    {
+        for(uint64_t i = 1; running; i++)
+        {
+            seqlock.store(Value{i, i, i});
+        }
+    });
+
+    // Counted instead of asserted, the writer has to be joined in any case
+    uint64_t last = 0, torn = 0, backwards = 0;
+    for(int i = 0; i < 100000; i++)
+    {
+        Value value = seqlock.load();
+        torn += value.a != value.b || value.a != value.c;
+        // The writer only moves forward
+        backwards += value.a < last;
+        last = value.a;
+    }
+    running = false;
+    writer.join();
+    EXPECT_EQ(0u, torn);
+    EXPECT_EQ(0u, backwards);
+}
@@ -0,0 +1,111 @@
+#include <ros_gremsy/spsc_queue.h>
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(SPSCQueue, RoundsCapacityUpToPowerOfTwo)
+{
+    EXPECT_EQ(2u, SPSCQueue<int>(0).capacity());
+    EXPECT_EQ(2u, SPSCQueue<int>(2).capacity());
+    EXPECT_EQ(8u, SPSCQueue<int>(5).capacity());
+    EXPECT_EQ(64u, SPSCQueue<int>(64).capacity());
+
+    SPSCQueue<int> queue(4);
+    queue.resize(100);
+    EXPECT_EQ(128u, queue.capacity());
+}
+
+TEST(SPSCQueue, PopsInPushOrder)
+{
+    SPSCQueue<int> queue(4);
+    int item;
+    EXPECT_FALSE(queue.pop(item));
+
+    for(int i = 0; i < 3; i++)
+    {
+        EXPECT_TRUE(queue.push(i));
+    }
+    EXPECT_EQ(3u, queue.size());
+    for(int i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(queue.pop(item));
+        EXPECT_EQ(i, item);
+    }
+    EXPECT_EQ(0u, queue.size());
+    EXPECT_FALSE(queue.pop(item));
+}
+
+TEST(SPSCQueue, RejectsPushWhenFull)
+{
+    SPSCQueue<int> queue(4);
+    for(int i = 0; i < 4; i++)
+    {
+        EXPECT_TRUE(queue.push(i));
+    }
+    EXPECT_FALSE(queue.push(4));
+    EXPECT_EQ(4u, queue.size());
+
+    // A popped item makes room for exactly one more
+    int item;
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(0, item);
+    EXPECT_TRUE(queue.push(4));
+    EXPECT_FALSE(queue.push(5));
+}
+
+TEST(SPSCQueue, WrapsAround)
+{
+    SPSCQueue<int> queue(2);
+    int item;
+    for(int i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(queue.push(i));
+        ASSERT_TRUE(queue.pop(item));
+        EXPECT_EQ(i, item);
+    }
+}
+
+TEST(SPSCQueue, ResizeEmptiesQueue)
+{
+    SPSCQueue<int> queue(4);
+    queue.push(1);
+    queue.resize(4);
+    int item;
+    EXPECT_EQ(0u, queue.size());
+    EXPECT_FALSE(queue.pop(item));
+}
+
+TEST(SPSCQueue, TransfersEveryItemBetweenThreads)
+{
+    const int count = 100000;
+    SPSCQueue<int> queue(64);
+
+    std::thread producer([&queue, count]()
+    {
+        for(int i = 0; i < count; i++)
+        {
+            while(!queue.push(i))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // Counted instead of asserted, the producer has to be joined in any case
+    int expected = 0, misordered = 0;
+    while(expected < count)
+    {
+        int item;
+        if(queue.pop(item))
+        {
+            misordered += item != expected;
+            expected++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_EQ(0, misordered);
+    EXPECT_EQ(0u, queue.size());
+}
@@ -0,0 +1,49 @@
+#include <ros_gremsy/thread_scheduling.h>
+#include <gtest/gtest.h>
+
+TEST(ParseCpuList, EmptyList)
+{
+    std::vector<int> cpus = {1};
+    std::string error;
+    EXPECT_TRUE(parseCpuList("", cpus, error));
+    EXPECT_TRUE(cpus.empty());
+}
+
+TEST(ParseCpuList, SingleCpus)
+{
+    std::vector<int> cpus;
+    std::string error;
+    ASSERT_TRUE(parseCpuList("2,3", cpus, error));
+    EXPECT_EQ(std::vector<int>({2, 3}), cpus);
+}
+
+TEST(ParseCpuList, Ranges)
+{
+    std::vector<int> cpus;
+    std::string error;
+    ASSERT_TRUE(parseCpuList("0-3,6", cpus, error));
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 6}), cpus);
+    ASSERT_TRUE(parseCpuList("5-5", cpus, error));
+    EXPECT_EQ(std::vector<int>({5}), cpus);
+}
+
+TEST(ParseCpuList, RejectsInvalidRanges)
+{
+    const char* lists[] = {"1-", "a", "3-1", "0--2", "-1", "1,2x", "100000"};
+    for(const char* list : lists)
+    {
+        std::vector<int> cpus;
+        std::string error;
+        EXPECT_FALSE(parseCpuList(list, cpus, error)) << list;
+        EXPECT_TRUE(cpus.empty()) << list;
+        EXPECT_FALSE(error.empty()) << list;
+    }
+}
+
+TEST(ParseCpuList, NamesInvalidRange)
+{
+    std::vector<int> cpus;
+    std::string error;
+    EXPECT_FALSE(parseCpuList("0,3-1", cpus, error));
+    EXPECT_EQ("invalid CPU \"3-1\" in \"0,3-1\"", error);
+}
@@ -0,0 +1,159 @@
+#include <ros_gremsy/trajectory.h>
+#include <gtest/gtest.h>
+
+#define TOLERANCE 1e-9
+
+namespace
+{
+
+const ros::Time receive_time(100.0);
+
+ros_gremsy::GimbalTrajectoryPoint waypoint(double time_from_start, double roll, double pitch, double yaw)
+{
+    ros_gremsy::GimbalTrajectoryPoint point;
+    point.time_from_start = ros::Duration(time_from_start);
+    point.angles.x = roll;
+    point.angles.y = pitch;
+    point.angles.z = yaw;
+    return point;
+}
+
+// Three waypoints, starting on reception
+ros_gremsy::GimbalTrajectory threeWaypoints()
+{
+    ros_gremsy::GimbalTrajectory trajectory;
+    trajectory.points.push_back(waypoint(0.0, 0.0, 0.0, 0.0));
+    trajectory.points.push_back(waypoint(1.0, 0.1, -0.5, 1.0));
+    trajectory.points.push_back(waypoint(3.0, 0.2, -1.0, -1.0));
+    return trajectory;
+}
+
+geometry_msgs::Vector3 sample(Trajectory& trajectory, double t)
+{
+    geometry_msgs::Vector3 angles;
+    EXPECT_TRUE(trajectory.sample(receive_time + ros::Duration(t), angles));
+    return angles;
+}
+
+}
+
+TEST(Trajectory, RejectsEmptyTrajectory)
+{
+    Trajectory trajectory;
+    std::string error;
+    EXPECT_FALSE(trajectory.set(ros_gremsy::GimbalTrajectory(), receive_time, error));
+    EXPECT_EQ("the trajectory contains no waypoints", error);
+    EXPECT_FALSE(trajectory.active());
+}
+
+TEST(Trajectory, RejectsUnorderedWaypoints)
+{
+    ros_gremsy::GimbalTrajectory message = threeWaypoints();
+    message.points[2].time_from_start = message.points[1].time_from_start;
+    Trajectory trajectory;
+    std::string error;
+    EXPECT_FALSE(trajectory.set(message, receive_time, error));
+    EXPECT_EQ("the waypoints are not ordered by strictly increasing time", error);
+    EXPECT_FALSE(trajectory.active());
+}
+
+TEST(Trajectory, PassesWaypoints)
+{
+    Trajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.set(threeWaypoints(), receive_time, error));
+    EXPECT_TRUE(trajectory.active());
+
+    geometry_msgs::Vector3 angles = sample(trajectory, 0.0);
+    EXPECT_NEAR(0.0, angles.y, TOLERANCE);
+    angles = sample(trajectory, 1.0);
+    EXPECT_NEAR(0.1, angles.x, TOLERANCE);
+    EXPECT_NEAR(-0.5, angles.y, TOLERANCE);
+    EXPECT_NEAR(1.0, angles.z, TOLERANCE);
+}
+
+TEST(Trajectory, HoldsFirstWaypointBeforeStart)
+{
+    Trajectory trajectory;
+    std::string error;
+    ros_gremsy::GimbalTrajectory message = threeWaypoints();
+    message.points[0] = waypoint(0.5, 0.0, 0.3, 0.0);
+    ASSERT_TRUE(trajectory.set(message, receive_time, error));
+    EXPECT_NEAR(0.3, sample(trajectory, -1.0).y, TOLERANCE);
+    EXPECT_NEAR(0.3, sample(trajectory, 0.25).y, TOLERANCE);
+    EXPECT_TRUE(trajectory.active());
+}
+
+TEST(Trajectory, InterpolatesSmoothly)
+{
+    ros_gremsy::GimbalTrajectory message;
+    message.points.push_back(waypoint(0.0, 0.0, 0.0, 0.0));
+    message.points.push_back(waypoint(2.0, 0.0, 1.0, 0.0));
+    Trajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.set(message, receive_time, error));
+
+    // Between two waypoints at rest the spline is symmetric and rises monotonically
+    EXPECT_NEAR(0.5, sample(trajectory, 1.0).y, TOLERANCE);
+    double last = 0.0;
+    for(double t = 0.1; t < 2.0; t += 0.1)
+    {
+        double pitch = sample(trajectory, t).y;
+        EXPECT_GT(pitch, last);
+        last = pitch;
+    }
+    // It leaves and approaches the waypoints at rest
+    EXPECT_LT(sample(trajectory, 0.01).y, 0.001);
+    EXPECT_GT(sample(trajectory, 1.99).y, 0.999);
+}
+
+TEST(Trajectory, FinishesAtLastWaypoint)
+{
+    Trajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.set(threeWaypoints(), receive_time, error));
+    sample(trajectory, 2.0);
+
+    geometry_msgs::Vector3 angles = sample(trajectory, 5.0);
+    EXPECT_NEAR(0.2, angles.x, TOLERANCE);
+    EXPECT_NEAR(-1.0, angles.y, TOLERANCE);
+    EXPECT_NEAR(-1.0, angles.z, TOLERANCE);
+
+    // The last waypoint is sent once
+    EXPECT_FALSE(trajectory.active());
+    EXPECT_FALSE(trajectory.sample(receive_time + ros::Duration(6.0), angles));
+}
+
+TEST(Trajectory, StartsAtHeaderStamp)
+{
+    ros_gremsy::GimbalTrajectory message = threeWaypoints();
+    message.header.stamp = receive_time + ros::Duration(10.0);
+    Trajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.set(message, receive_time, error));
+
+    EXPECT_NEAR(0.0, sample(trajectory, 5.0).y, TOLERANCE);
+    EXPECT_NEAR(-0.5, sample(trajectory, 11.0).y, TOLERANCE);
+}
+
+TEST(Trajectory, SamplesBackwardsInTime)
+{
+    Trajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.set(threeWaypoints(), receive_time, error));
+    double late = sample(trajectory, 2.5).z;
+    double early = sample(trajectory, 0.5).z;
+    EXPECT_NEAR(late, sample(trajectory, 2.5).z, TOLERANCE);
+    EXPECT_NEAR(early, sample(trajectory, 0.5).z, TOLERANCE);
+}
+
+TEST(Trajectory, ClearStopsTrajectory)
+{
+    Trajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.set(threeWaypoints(), receive_time, error));
+    trajectory.clear();
+    EXPECT_FALSE(trajectory.active());
+    geometry_msgs::Vector3 angles;
+    EXPECT_FALSE(trajectory.sample(receive_time, angles));
+}
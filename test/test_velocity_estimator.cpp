@@ -0,0 +1,145 @@
+#include <ros_gremsy/velocity_estimator.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+#define SAMPLE_PERIOD 0.01
+
+namespace
+{
+
+// Feeds the angles of a constant rotation and returns the last estimate
+bool rotate(VelocityEstimator& estimator, const double rate[3], size_t samples, double velocity[3])
+{
+    bool estimated = false;
+    for(size_t i = 0; i < samples; i++)
+    {
+        double t = i * SAMPLE_PERIOD;
+        double angles[3];
+        for(int axis = 0; axis < 3; axis++)
+        {
+            angles[axis] = std::remainder(rate[axis] * t, 2.0 * M_PI);
+        }
+        estimated = estimator.update(ros::Time(100.0 + t), angles, velocity);
+    }
+    return estimated;
+}
+
+VelocityEstimator estimator(int method)
+{
+    VelocityEstimator estimator;
+    VelocityEstimator::Parameters parameters;
+    parameters.method = method;
+    estimator.configure(parameters);
+    return estimator;
+}
+
+}
+
+TEST(VelocityEstimator, NeedsTwoSamples)
+{
+    VelocityEstimator estimator = ::estimator(VelocityEstimator::FINITE_DIFFERENCE);
+    const double angles[3] = {0.1, 0.2, 0.3};
+    double velocity[3];
+    EXPECT_FALSE(estimator.update(ros::Time(1.0), angles, velocity));
+    EXPECT_TRUE(estimator.update(ros::Time(1.01), angles, velocity));
+    EXPECT_NEAR(0.0, velocity[0], 1e-9);
+}
+
+TEST(VelocityEstimator, DifferentiatesAngles)
+{
+    VelocityEstimator estimator = ::estimator(VelocityEstimator::FINITE_DIFFERENCE);
+    const double rate[3] = {0.5, -1.0, 2.0};
+    double velocity[3];
+    ASSERT_TRUE(rotate(estimator, rate, 10, velocity));
+    for(int axis = 0; axis < 3; axis++)
+    {
+        EXPECT_NEAR(rate[axis], velocity[axis], 1e-6);
+    }
+}
+
+TEST(VelocityEstimator, WrapsAngles)
+{
+    // Crossing from pi to -pi is a small step forward, not a full turn backwards
+    const int methods[] = {VelocityEstimator::FINITE_DIFFERENCE, VelocityEstimator::KALMAN};
+    for(int method : methods)
+    {
+        VelocityEstimator estimator = ::estimator(method);
+        const double rate[3] = {3.0, -3.0, 0.0};
+        double velocity[3];
+        // The yaw crosses the wrap around after about one second
+        ASSERT_TRUE(rotate(estimator, rate, 200, velocity));
+        EXPECT_NEAR(3.0, velocity[0], 0.01) << method;
+        EXPECT_NEAR(-3.0, velocity[1], 0.01) << method;
+    }
+}
+
+TEST(VelocityEstimator, KalmanConvergesToRate)
+{
+    VelocityEstimator estimator = ::estimator(VelocityEstimator::KALMAN);
+    const double rate[3] = {0.5, -1.0, 0.0};
+    double velocity[3];
+    ASSERT_TRUE(rotate(estimator, rate, 300, velocity));
+    EXPECT_NEAR(0.5, velocity[0], 1e-3);
+    EXPECT_NEAR(-1.0, velocity[1], 1e-3);
+    EXPECT_NEAR(0.0, velocity[2], 1e-3);
+}
+
+TEST(VelocityEstimator, KalmanSmoothsNoise)
+{
+    VelocityEstimator estimator = ::estimator(VelocityEstimator::KALMAN);
+    VelocityEstimator finite_difference = ::estimator(VelocityEstimator::FINITE_DIFFERENCE);
+    double kalman_error = 0.0, finite_difference_error = 0.0;
+    for(int i = 0; i < 500; i++)
+    {
+        // Alternating measurement noise of the encoder on a gimbal at rest
+        ros::Time stamp(100.0 + i * SAMPLE_PERIOD);
+        double noise = i % 2 ? 0.001 : -0.001;
+        const double angles[3] = {noise, noise, noise};
+        double velocity[3];
+        if(estimator.update(stamp, angles, velocity) && i >= 100)
+        {
+            kalman_error = std::max(kalman_error, std::abs(velocity[0]));
+        }
+        if(finite_difference.update(stamp, angles, velocity) && i >= 100)
+        {
+            finite_difference_error = std::max(finite_difference_error, std::abs(velocity[0]));
+        }
+    }
+    EXPECT_LT(kalman_error, 0.5 * finite_difference_error);
+}
+
+TEST(VelocityEstimator, ResetsAfterGap)
+{
+    VelocityEstimator estimator = ::estimator(VelocityEstimator::FINITE_DIFFERENCE);
+    const double angles[3] = {0.0, 0.0, 0.0};
+    const double moved[3] = {1.0, 1.0, 1.0};
+    double velocity[3];
+    estimator.update(ros::Time(1.0), angles, velocity);
+    ASSERT_TRUE(estimator.update(ros::Time(1.01), angles, velocity));
+
+    // A gap of more than a second starts a new estimation instead of reporting the mean rate
+    EXPECT_FALSE(estimator.update(ros::Time(3.0), moved, velocity));
+    EXPECT_TRUE(estimator.update(ros::Time(3.01), moved, velocity));
+    EXPECT_NEAR(0.0, velocity[0], 1e-9);
+
+    // As well as a stamp which does not increase
+    EXPECT_FALSE(estimator.update(ros::Time(3.01), angles, velocity));
+}
+
+TEST(VelocityEstimator, MethodChangeResets)
+{
+    VelocityEstimator estimator = ::estimator(VelocityEstimator::FINITE_DIFFERENCE);
+    const double angles[3] = {0.0, 0.0, 0.0};
+    double velocity[3];
+    estimator.update(ros::Time(1.0), angles, velocity);
+
+    VelocityEstimator::Parameters parameters;
+    parameters.method = VelocityEstimator::KALMAN;
+    estimator.configure(parameters);
+    EXPECT_FALSE(estimator.update(ros::Time(1.01), angles, velocity));
+
+    // Other parameters keep the running estimation
+    parameters.process_noise = 10.0;
+    estimator.configure(parameters);
+    EXPECT_TRUE(estimator.update(ros::Time(1.02), angles, velocity));
+}
@@ -0,0 +1,249 @@
+// Replay of telemetry logs recorded by the GimbalNode.
+//
+// The recorded MAVLink frames are written with their original spacing into a pseudo terminal,
+// which the GimbalNode running in this process opens as its serial device. So the replayed
+// telemetry takes the same path through the SDK or the direct telemetry and the conversion as
+// on the gimbal, and is published on the usual topics.
+//
+// Run with: roslaunch ros_gremsy replay.launch files:="ros_gremsy_telemetry_20260101-120000_0000.tlm"
+#include <ros_gremsy/ros_gremsy.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <vector>
+
+// Simulated gimbal on the master side of a pseudo terminal which replays the logs
+class LogReplayer
+{
+public:
+    // Params: (log files in the order of replay, speed relative to the recording)
+    LogReplayer(const std::vector<std::string>& files, double rate) :
+        files_(files),
+        rate_(rate)
+    {
+    }
+
+    ~LogReplayer()
+    {
+        stop();
+        if(slave_fd_ >= 0)
+        {
+            close(slave_fd_);
+        }
+        if(master_fd_ >= 0)
+        {
+            close(master_fd_);
+        }
+    }
+
+    // Creates the pseudo terminal, returns false on failure
+    bool open()
+    {
+        master_fd_ = posix_openpt(O_RDWR | O_NOCTTY);
+        if(master_fd_ < 0 || grantpt(master_fd_) != 0 || unlockpt(master_fd_) != 0)
+        {
+            return false;
+        }
+        device_ = ptsname(master_fd_);
+
+        // Keep the slave open and raw, so no data is mangled before the node configured the port
+        slave_fd_ = ::open(device_.c_str(), O_RDWR | O_NOCTTY);
+        if(slave_fd_ < 0)
+        {
+            return false;
+        }
+        termios config;
+        tcgetattr(slave_fd_, &config);
+        cfmakeraw(&config);
+        tcsetattr(slave_fd_, TCSANOW, &config);
+
+        fcntl(master_fd_, F_SETFL, fcntl(master_fd_, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    // Device path the node has to open
+    const std::string& device() const
+    {
+        return device_;
+    }
+
+    void start()
+    {
+        running_ = true;
+        thread_ = std::thread(&LogReplayer::run, this);
+    }
+
+    void stop()
+    {
+        running_ = false;
+        if(thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    bool finished() const
+    {
+        return finished_;
+    }
+
+    std::atomic<uint64_t> frames_sent{0}, heartbeats_sent{0};
+
+private:
+    void run()
+    {
+        typedef std::chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+        clock::time_point last_heartbeat = start - std::chrono::seconds(1);
+        uint64_t first_stamp = 0;
+
+        for(const std::string& file : files_)
+        {
+            TelemetryLogReader reader;
+            std::string error;
+            if(!reader.open(file, error))
+            {
+                ROS_ERROR("Skipping %s, %s", file.c_str(), error.c_str());
+                continue;
+            }
+            ROS_INFO("Replaying %s", file.c_str());
+
+            TelemetryRecordHeader record;
+            const uint8_t* frame;
+            while(running_ && reader.next(record, frame))
+            {
+                // The receive time stamps continue across the files of a recording
+                if(first_stamp == 0)
+                {
+                    first_stamp = record.receive_stamp;
+                }
+                clock::time_point send_time = start + std::chrono::duration_cast<clock::duration>(
+                    std::chrono::duration<double>((int64_t) (record.receive_stamp - first_stamp) * 1e-6 / rate_));
+
+                // The SDK waits for heartbeats, which are missing if only its decoded telemetry was recorded
+                while(running_ && clock::now() < send_time)
+                {
+                    if(clock::now() - last_heartbeat >= std::chrono::seconds(1))
+                    {
+                        sendHeartbeat();
+                        last_heartbeat = clock::now();
+                    }
+                    discardInput();
+                    std::this_thread::sleep_until(std::min(send_time, last_heartbeat + std::chrono::seconds(1)));
+                }
+
+                if(messageId(frame, record.length) == MAVLINK_MSG_ID_HEARTBEAT)
+                {
+                    last_heartbeat = clock::now();
+                }
+                send(frame, record.length);
+                frames_sent++;
+            }
+        }
+        finished_ = true;
+    }
+
+    // Message id of a MAVLink 1 or 2 frame, -1 for anything else
+    static int64_t messageId(const uint8_t* frame, size_t length)
+    {
+        if(length >= 10 && frame[0] == MAVLINK_STX)
+        {
+            return frame[7] | (frame[8] << 8) | (frame[9] << 16);
+        }
+        if(length >= 6 && frame[0] == MAVLINK_STX_MAVLINK1)
+        {
+            return frame[5];
+        }
+        return -1;
+    }
+
+    void sendHeartbeat()
+    {
+        mavlink_message_t message;
+        mavlink_msg_heartbeat_pack(system_id, component_id, &message, 26, 0, 0, 0, 4);
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+        send(buffer, length);
+        heartbeats_sent++;
+    }
+
+    void send(const uint8_t* data, size_t length)
+    {
+        if(write(master_fd_, data, length) != (ssize_t) length)
+        {
+            ROS_WARN_THROTTLE(1.0, "Replay could not write a complete frame");
+        }
+    }
+
+    // Discard everything the node sends, so its writes never block
+    void discardInput()
+    {
+        uint8_t buffer[256];
+        while(read(master_fd_, buffer, sizeof(buffer)) > 0);
+    }
+
+    static constexpr uint8_t system_id = 1;
+    static constexpr uint8_t component_id = 154; // MAV_COMP_ID_GIMBAL
+
+    std::vector<std::string> files_;
+    double rate_;
+    int master_fd_ = -1, slave_fd_ = -1;
+    std::string device_;
+    std::thread thread_;
+    std::atomic<bool> running_{false}, finished_{false};
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "ros_gremsy_replay");
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    // The remaining arguments are the log files
+    std::vector<std::string> files(argv + 1, argv + argc);
+    if(files.empty())
+    {
+        ROS_FATAL("Usage: ros_gremsy_replay <log files>");
+        return 1;
+    }
+
+    double rate;
+    pnh.param("replay_rate", rate, 1.0);
+    if(rate <= 0.0)
+    {
+        ROS_FATAL("The replay rate has to be positive");
+        return 1;
+    }
+
+    LogReplayer replayer(files, rate);
+    if(!replayer.open())
+    {
+        ROS_FATAL("Could not create the pseudo terminal for the replay: %s", strerror(errno));
+        return 1;
+    }
+    replayer.start();
+
+    // The node reads its config from the private namespace of this process, a replay is never recorded again
+    pnh.setParam("device", replayer.device());
+    pnh.setParam("transport", SERIAL_TRANSPORT);
+    pnh.setParam("record", false);
+    GimbalNode node(nh, pnh);
+
+    // Serves the global queue, which holds the subscriber callbacks deciding which streams are converted
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+
+    ros::WallRate poll(10.0);
+    while(ros::ok() && !replayer.finished())
+    {
+        poll.sleep();
+    }
+
+    // Give the node the time to publish the last frames
+    ros::WallDuration(0.5).sleep();
+    replayer.stop();
+    spinner.stop();
+    ROS_INFO("Replayed %lu frames, %lu heartbeats added", replayer.frames_sent.load(), replayer.heartbeats_sent.load());
+    return 0;
+}